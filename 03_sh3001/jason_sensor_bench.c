@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <ctype.h>
+#include <math.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "libjason_sensor.h"
+
+/*
+ * 传感器数据通路的延时和抖动测试，每个读取路径和上报周期的组合输出一行 JSON：
+ *   - 采集到读取的延时：用户态读到样本时的 CLOCK_BOOTTIME 减去样本的采集时间戳
+ *   - 周期抖动：相邻样本时间戳之差的平均值、标准差和最大偏差
+ *   - 实际频率与请求频率
+ *   - 每个样本的 CPU 时间：本进程，以及名字以 -w 指定前缀开头的内核线程（默认为采集线程 sensor/）
+ * 轮询和中断模式由设备树决定，用 -m 标注在结果中；与 jason_sh3001_sim 配合时见 jason_sensor_bench.sh。
+ */
+
+#define BENCH_DEFAULT_SAMPLES   1000
+#define BENCH_WARMUP_SAMPLES    10
+#define BENCH_READ_BATCH        64
+
+static const char *path_name[] = {
+    [JSENSOR_PATH_MMAP] = "mmap",
+    [JSENSOR_PATH_BATCH] = "batch",
+    [JSENSOR_PATH_READ] = "read",
+};
+
+struct bench_config {
+    enum jsensor_type type;
+    const char *dev;
+    const char *mode;
+    const char *worker;
+    unsigned int periods[32];
+    int period_count;
+    int paths[3];
+    int path_count;
+    unsigned int samples;
+};
+
+struct bench_result {
+    unsigned int count;
+    unsigned long long dropped;
+    long long *latency;         // 每个样本的延时
+    long long *interval;        // 相邻样本的间隔，count - 1 个
+    long long first_ts, last_ts;
+    long long cpu_self_ns;
+    long long cpu_driver_ns;
+};
+
+static long long now_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long self_cpu_ns(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL +
+        (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+}
+
+// 名字以 prefix 开头的所有任务（内核线程）的 CPU 时间之和，读 /proc/<pid>/stat
+static long long driver_cpu_ns(const char *prefix)
+{
+    long ticks = sysconf(_SC_CLK_TCK);
+    unsigned long long utime, stime, total = 0;
+    char path[64], buf[512], *comm, *end;
+    struct dirent *entry;
+    DIR *dir;
+    FILE *fp;
+
+    if (!prefix || !*prefix)
+        return 0;
+
+    dir = opendir("/proc");
+    if (!dir)
+        return 0;
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (!isdigit((unsigned char)entry->d_name[0]))
+            continue;
+        snprintf(path, sizeof(path), "/proc/%.16s/stat", entry->d_name);
+        fp = fopen(path, "r");
+        if (!fp)
+            continue;
+        if (!fgets(buf, sizeof(buf), fp)) {
+            fclose(fp);
+            continue;
+        }
+        fclose(fp);
+
+        /* pid (comm) state ppid ... 第 14、15 项为 utime、stime */
+        comm = strchr(buf, '(');
+        end = strrchr(buf, ')');
+        if (!comm || !end)
+            continue;
+        *end = '\0';
+        if (strncmp(comm + 1, prefix, strlen(prefix)))
+            continue;
+        if (sscanf(end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+                &utime, &stime) == 2)
+            total += utime + stime;
+    }
+    closedir(dir);
+
+    return total * (1000000000LL / ticks);
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// 已排序数组的百分位数，permille 为千分比
+static long long percentile(const long long *sorted, unsigned int count, int permille)
+{
+    if (!count)
+        return 0;
+
+    return sorted[(unsigned long long)(count - 1) * permille / 1000];
+}
+
+static int bench_run(const struct bench_config *cfg, struct jsensor *s,
+            unsigned int period_us, struct bench_result *res)
+{
+    struct sensor_sample samples[BENCH_READ_BATCH];
+    unsigned int warmup = BENCH_WARMUP_SAMPLES;
+    long long read_ns, prev_ts = 0;
+    unsigned long long dropped;
+    int i, n, timeout_ms;
+
+    timeout_ms = period_us / 1000 * 2 + 1000;
+
+    if (jsensor_set_period_us(s, period_us) < 0 && cfg->type != JSENSOR_TEMPERATURE)
+        return -1;
+    if (jsensor_start(s) < 0)
+        return -1;
+
+    /* 丢掉刚打开时的样本，周期切换和芯片上电的影响不计入结果 */
+    while (warmup) {
+        n = jsensor_read(s, samples, warmup < BENCH_READ_BATCH ? warmup : BENCH_READ_BATCH, timeout_ms);
+        if (n <= 0)
+            goto fail;
+        warmup -= n;
+        prev_ts = samples[n - 1].timestamp;
+    }
+
+    res->count = 0;
+    res->first_ts = prev_ts;
+    dropped = jsensor_dropped(s);
+    res->cpu_self_ns = self_cpu_ns();
+    res->cpu_driver_ns = driver_cpu_ns(cfg->worker);
+
+    while (res->count < cfg->samples) {
+        n = cfg->samples - res->count;
+        n = jsensor_read(s, samples, n < BENCH_READ_BATCH ? n : BENCH_READ_BATCH, timeout_ms);
+        if (n <= 0)
+            goto fail;
+        read_ns = now_ns(CLOCK_BOOTTIME);
+
+        for (i = 0; i < n; i++) {
+            res->latency[res->count] = read_ns - samples[i].timestamp;
+            res->interval[res->count] = samples[i].timestamp - prev_ts;
+            prev_ts = samples[i].timestamp;
+            res->count++;
+        }
+    }
+
+    res->cpu_self_ns = self_cpu_ns() - res->cpu_self_ns;
+    res->cpu_driver_ns = driver_cpu_ns(cfg->worker) - res->cpu_driver_ns;
+    res->last_ts = prev_ts;
+    res->dropped = jsensor_dropped(s) - dropped;
+    jsensor_stop(s);
+
+    return 0;
+
+fail:
+    fprintf(stderr, "%s: read failed at period %uus: %s\n", jsensor_type_name(cfg->type),
+        period_us, n ? strerror(-n) : "timeout");
+    jsensor_stop(s);
+    return -1;
+}
+
+static void bench_report(const struct bench_config *cfg, int path,
+            unsigned int period_us, struct bench_result *res)
+{
+    long long mean, max_dev = 0, dev;
+    double var = 0, achieved;
+    unsigned int i, n = res->count;
+
+    mean = (res->last_ts - res->first_ts) / n;
+    for (i = 0; i < n; i++) {
+        dev = res->interval[i] - mean;
+        var += (double)dev * dev;
+        if (llabs(dev) > max_dev)
+            max_dev = llabs(dev);
+        res->interval[i] = llabs(dev);
+    }
+    achieved = 1e9 * n / (double)(res->last_ts - res->first_ts);
+
+    qsort(res->latency, n, sizeof(long long), cmp_ll);
+    qsort(res->interval, n, sizeof(long long), cmp_ll);
+
+    printf("{\"sensor\":\"%s\",\"mode\":\"%s\",\"path\":\"%s\",\"period_us\":%u,"
+        "\"samples\":%u,\"dropped\":%llu,\"requested_hz\":%.3f,\"achieved_hz\":%.3f,"
+        "\"latency_p50_ns\":%lld,\"latency_p90_ns\":%lld,\"latency_p99_ns\":%lld,\"latency_max_ns\":%lld,"
+        "\"interval_mean_ns\":%lld,\"interval_stddev_ns\":%.0f,\"interval_p99_dev_ns\":%lld,\"interval_max_dev_ns\":%lld,"
+        "\"cpu_self_ns_per_sample\":%lld,\"cpu_driver_ns_per_sample\":%lld}\n",
+        jsensor_type_name(cfg->type), cfg->mode, path_name[path], period_us,
+        n, res->dropped, 1e6 / period_us, achieved,
+        percentile(res->latency, n, 500), percentile(res->latency, n, 900),
+        percentile(res->latency, n, 990), res->latency[n - 1],
+        mean, sqrt(var / n), percentile(res->interval, n, 990), max_dev,
+        res->cpu_self_ns / n, res->cpu_driver_ns / n);
+    fflush(stdout);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s [-s accel|gyro|temperature|angle] [-d dev] [-p period_ms,...]\n"
+        "          [-r mmap,batch,read] [-n samples] [-m mode] [-w thread-prefix]\n"
+        "  -p  reporting periods in ms, default 5,10,20,50,100,200\n"
+        "  -r  read paths to test, default all the driver supports\n"
+        "  -n  samples per run, default %d\n"
+        "  -m  acquisition mode label written to the results (poll/irq), default poll\n"
+        "  -w  kernel thread name prefix counted as driver CPU time, default sensor/\n",
+        prog, BENCH_DEFAULT_SAMPLES);
+}
+
+static int parse_type(const char *name)
+{
+    int type;
+
+    for (type = 0; type < JSENSOR_TYPE_NUM; type++) {
+        if (strstr(jsensor_type_name(type), name))
+            return type;
+    }
+
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned int default_periods[] = { 5, 10, 20, 50, 100, 200 };
+    struct bench_config cfg = {
+        .type = JSENSOR_ACCEL,
+        .mode = "poll",
+        .worker = "sensor/",
+        .samples = BENCH_DEFAULT_SAMPLES,
+    };
+    struct bench_result res;
+    struct jsensor *s;
+    char *tok, *save;
+    int opt, i, j, ret = 0;
+
+    while ((opt = getopt(argc, argv, "s:d:p:r:n:m:w:h")) != -1) {
+        switch (opt) {
+        case 's':
+            cfg.type = parse_type(optarg);
+            if ((int)cfg.type < 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'd':
+            cfg.dev = optarg;
+            break;
+        case 'p':
+            for (tok = strtok_r(optarg, ",", &save); tok && cfg.period_count < 32;
+                    tok = strtok_r(NULL, ",", &save))
+                cfg.periods[cfg.period_count++] = strtoul(tok, NULL, 0) * 1000;
+            break;
+        case 'r':
+            for (tok = strtok_r(optarg, ",", &save); tok && cfg.path_count < 3;
+                    tok = strtok_r(NULL, ",", &save)) {
+                for (j = 0; j < 3; j++) {
+                    if (!strcmp(tok, path_name[j]))
+                        cfg.paths[cfg.path_count++] = j;
+                }
+            }
+            break;
+        case 'n':
+            cfg.samples = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            cfg.mode = optarg;
+            break;
+        case 'w':
+            cfg.worker = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (!cfg.period_count) {
+        for (i = 0; i < (int)(sizeof(default_periods) / sizeof(default_periods[0])); i++)
+            cfg.periods[cfg.period_count++] = default_periods[i] * 1000;
+    }
+    if (!cfg.path_count) {
+        for (j = 0; j < 3; j++)
+            cfg.paths[cfg.path_count++] = j;
+    }
+    if (cfg.samples < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    res.latency = calloc(cfg.samples, sizeof(long long));
+    res.interval = calloc(cfg.samples, sizeof(long long));
+    if (!res.latency || !res.interval)
+        return 1;
+
+    s = jsensor_open(cfg.type, cfg.dev);
+    if (!s) {
+        perror("open sensor");
+        return 1;
+    }
+
+    for (j = 0; j < cfg.path_count; j++) {
+        if (jsensor_set_path(s, cfg.paths[j]) < 0) {
+            fprintf(stderr, "%s: read path %s not supported, skipped\n",
+                jsensor_type_name(cfg.type), path_name[cfg.paths[j]]);
+            continue;
+        }
+        for (i = 0; i < cfg.period_count; i++) {
+            if (bench_run(&cfg, s, cfg.periods[i], &res) < 0) {
+                ret = 1;
+                continue;
+            }
+            bench_report(&cfg, cfg.paths[j], cfg.periods[i], &res);
+        }
+    }
+
+    jsensor_close(s);
+    free(res.latency);
+    free(res.interval);
+
+    return ret;
+}
@@ -0,0 +1,120 @@
+#!/bin/sh
+#
+# 在模拟的 SH3001 上跑 jason_sensor_bench，或者对比两次的结果。
+#
+#   jason_sensor_bench.sh run <i2c 从模式总线号> [输出文件] [jason_sensor_bench 的参数...]
+#       加载 jason_sh3001_sim 并在该总线上创建模拟芯片，加载驱动后对 accel、gyro、angle 跑全部周期和读取路径。
+#       驱动侧的设备树需要描述同一地址上的 SH3001（0x36），IRQ_GPIO 不为空时模拟芯片在该 GPIO 上产生数据就绪中断。
+#
+#   jason_sensor_bench.sh compare <基准结果> <新结果> [允许变差的百分比，默认 20]
+#       按 sensor、mode、path、period_us 对应两次的结果，p99 延时、抖动、CPU 时间变大或实际频率变低超过阈值时
+#       打印出来并返回 1。
+#
+
+set -e
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+SIM_ADDR=0x1036			# 0x1000 表示本机作为从设备的地址
+SENSORS="accel gyro angle"
+
+bench_run()
+{
+	bus=$1
+	out=${2:-bench-$(date +%Y%m%d-%H%M%S).jsonl}
+	shift
+	[ $# -gt 0 ] && shift
+
+	if [ -n "$IRQ_GPIO" ]; then
+		insmod "$BENCH_DIR/jason_sh3001_sim.ko" irq_gpio="$IRQ_GPIO"
+		mode=irq
+	else
+		insmod "$BENCH_DIR/jason_sh3001_sim.ko"
+		mode=poll
+	fi
+	echo slave-sh3001 $SIM_ADDR > /sys/bus/i2c/devices/i2c-$bus/new_device
+	insmod "$BENCH_DIR/jason_sensor_dev.ko"
+	insmod "$BENCH_DIR/jason_sh3001.ko"
+	sleep 1
+
+	: > "$out"
+	for sensor in $SENSORS; do
+		"$BENCH_DIR/jason_sensor_bench" -s $sensor -m $mode "$@" >> "$out" || true
+	done
+
+	rmmod jason_sh3001 jason_sensor_dev
+	echo $SIM_ADDR > /sys/bus/i2c/devices/i2c-$bus/delete_device
+	rmmod jason_sh3001_sim
+
+	echo "results in $out"
+}
+
+bench_compare()
+{
+	awk -v limit="${3:-20}" '
+	function field(line, name,    re) {
+		re = "\"" name "\":\"?[^,\"}]*"
+		if (!match(line, re))
+			return ""
+		line = substr(line, RSTART + length(name) + 3, RLENGTH - length(name) - 3)
+		sub(/^"/, "", line)
+		return line
+	}
+	function key(line) {
+		return field(line, "sensor") "/" field(line, "mode") "/" field(line, "path") "/" field(line, "period_us")
+	}
+	# higher 为 1 表示数值越大越差
+	function check(k, name, higher,    old, new, pct) {
+		old = base[k, name] + 0
+		new = field($0, name) + 0
+		if (old <= 0)
+			return
+		pct = (new - old) * 100 / old
+		if (!higher)
+			pct = -pct
+		if (pct > limit) {
+			printf "%s %s: %s -> %s (%+.1f%%)\n", k, name, old, new, higher ? pct : -pct
+			bad = 1
+		}
+	}
+	FNR == NR {
+		k = key($0)
+		split("latency_p99_ns interval_stddev_ns interval_p99_dev_ns cpu_self_ns_per_sample cpu_driver_ns_per_sample achieved_hz", names)
+		for (i in names)
+			base[k, names[i]] = field($0, names[i])
+		seen[k] = 1
+		next
+	}
+	{
+		k = key($0)
+		if (!(k in seen)) {
+			printf "%s: no baseline\n", k
+			next
+		}
+		check(k, "latency_p99_ns", 1)
+		check(k, "interval_stddev_ns", 1)
+		check(k, "interval_p99_dev_ns", 1)
+		check(k, "cpu_self_ns_per_sample", 1)
+		check(k, "cpu_driver_ns_per_sample", 1)
+		check(k, "achieved_hz", 0)
+	}
+	END {
+		exit bad
+	}' "$1" "$2"
+}
+
+case "$1" in
+run)
+	shift
+	[ $# -ge 1 ] || { echo "usage: $0 run <bus> [out.jsonl] [bench args...]" >&2; exit 2; }
+	bench_run "$@"
+	;;
+compare)
+	shift
+	[ $# -ge 2 ] || { echo "usage: $0 compare <base.jsonl> <new.jsonl> [percent]" >&2; exit 2; }
+	bench_compare "$@"
+	;;
+*)
+	echo "usage: $0 run|compare ..." >&2
+	exit 2
+	;;
+esac
@@ -17,14 +17,643 @@
 #include <linux/module.h>
 #include <linux/soc/rockchip/rk_vendor_storage.h>
 #include <linux/regulator/consumer.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/hrtimer.h>
+#include <linux/idr.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/version.h>
+#include <uapi/linux/sched/types.h>
+#include <linux/math64.h>
+#include <linux/pm_runtime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <asm/unaligned.h>
 #include "jason_sensor_dev.h"
+
+#define CREATE_TRACE_POINTS
+#include "jason_sensor_trace.h"
+
+/* i2c 传输由具体传感器驱动完成 */
+EXPORT_TRACEPOINT_SYMBOL(jason_sensor_i2c_start);
+EXPORT_TRACEPOINT_SYMBOL(jason_sensor_i2c_end);
  
 static struct class *jason_sensor_class;
+static struct dentry *sensor_debugfs_root;
 
 /* 定义了一个数组用来存放 sensor 的私有数据，每个 sensor 都有对应的私有数据结构体 */
-static struct sensor_private_data *g_sensor[SENSOR_NUM_TYPES];
-static struct sensor_operate *sensor_ops[SENSOR_NUM_ID_HIGH];
-static int sensor_probe_times[SENSOR_NUM_ID_HIGH];
+/* 每种类型的实例编号，编号 0 使用原来的设备节点名，其余在名字后加编号 */
+static struct ida sensor_ida[SENSOR_NUM_TYPES];
+
+/* misc 设备每次 open 对应的私有数据，记录该读者在样本环中的读取位置 */
+struct sensor_file {
+    struct sensor_private_data *sensor;
+    unsigned int seq;	/* 下一个要读取的样本序号 */
+    unsigned int events;	/* 该文件使能的事件，关闭文件时撤销 */
+};
+
+/**
+ * 从设备（companion）与主设备共用一个 i2c client 和同一套采集（轮询或中断），
+ * 采集相关的状态都保存在主设备中。
+ */
+static inline struct sensor_private_data *sensor_master(struct sensor_private_data *sensor)
+{
+    return sensor->master ? sensor->master : sensor;
+}
+
+/**
+ * 分配样本环。头部和样本数组放在同一块 vmalloc_user 内存中，以便整体 mmap 给用户态。
+ */
+static int sensor_ring_init(struct sensor_ring *ring, unsigned int size)
+{
+    struct sensor_ring_header *hdr;
+
+    /* overruns 由读者按 atomic_t 累加，见 sensor_ring_pop */
+    BUILD_BUG_ON(sizeof(atomic_t) != sizeof(hdr->overruns));
+
+    ring->mmap_size = PAGE_ALIGN(PAGE_SIZE + size * sizeof(struct sensor_sample));
+    hdr = vmalloc_user(ring->mmap_size);
+    if (!hdr)
+        return -ENOMEM;
+
+    hdr->magic = SENSOR_RING_MAGIC;
+    hdr->version = SENSOR_RING_VERSION;
+    hdr->format = SENSOR_SAMPLE_FMT_AXIS;
+    hdr->sample_size = sizeof(struct sensor_sample);
+    hdr->capacity = size;
+    hdr->data_offset = PAGE_SIZE;
+
+    ring->hdr = hdr;
+    ring->buf = (struct sensor_sample *)((char *)hdr + PAGE_SIZE);
+    ring->size = size;
+    init_waitqueue_head(&ring->wq);
+
+    return 0;
+}
+
+static void sensor_ring_free(void *data)
+{
+    struct sensor_ring *ring = data;
+
+    vfree(ring->hdr);
+}
+
+/**
+ * 将一个样本写入样本环，环满时覆盖最旧的样本，并唤醒等待的读者。
+ * 写者只有一个（调用者持有 sensor_mutex），读者不加锁，协议见 struct sensor_ring_header。
+ */
+static void sensor_ring_push(struct sensor_ring *ring, const struct sensor_axis *axis, ktime_t timestamp)
+{
+    unsigned int head = ring->hdr->write_seq;
+    struct sensor_sample *sample = &ring->buf[head & (ring->size - 1)];
+
+    WRITE_ONCE(sample->seq, head - 1);
+    smp_wmb();
+    sample->timestamp = ktime_to_ns(timestamp);
+    sample->flags = 0;
+    sample->axis = *axis;
+    smp_wmb();
+    WRITE_ONCE(sample->seq, head);
+    smp_store_release(&ring->hdr->write_seq, head + 1);
+
+    wake_up_interruptible(&ring->wq);
+}
+
+/**
+ * 从 *seq 处取出一个样本。读者落后超过一整个环，或者样本在拷贝过程中被覆盖时，
+ * 跳到最旧的有效样本，并在取出的样本上置 SENSOR_SAMPLE_FLAG_OVERRUN，
+ * 丢失的样本数累加到 *dropped（可以为 NULL）。
+ * 返回 1 表示取到样本，0 表示没有新样本。
+ */
+static int sensor_ring_pop(struct sensor_ring *ring, unsigned int *seq,
+            struct sensor_sample *sample, unsigned int *dropped)
+{
+    const struct sensor_sample *slot;
+    unsigned int head, lost = 0;
+
+    for (;;) {
+        head = smp_load_acquire(&ring->hdr->write_seq);
+        if (*seq == head)
+            return 0;
+
+        if (head - *seq > ring->size) {
+            lost += head - ring->size - *seq;
+            *seq = head - ring->size;
+        }
+
+        slot = &ring->buf[*seq & (ring->size - 1)];
+        if (READ_ONCE(slot->seq) != *seq)
+            goto overwritten;
+        smp_rmb();
+        *sample = *slot;
+        smp_rmb();
+        if (READ_ONCE(slot->seq) == *seq)
+            break;
+overwritten:
+        /* 写者已经绕回来覆盖了这个槽位，从当前最旧的样本重新开始 */
+        lost++;
+        (*seq)++;
+    }
+
+    (*seq)++;
+    if (lost) {
+        sample->flags |= SENSOR_SAMPLE_FLAG_OVERRUN;
+        /* 多个读者可能同时累加，用户态通过 mmap 只读这个字段，按 atomic_t 原子相加 */
+        atomic_add(lost, (atomic_t *)&ring->hdr->overruns);
+        if (dropped)
+            *dropped += lost;
+    }
+
+    return 1;
+}
+
+/* 读取最新样本，读到一半被发布者更新时重试 */
+static void sensor_get_axis(struct sensor_private_data *sensor, struct sensor_axis *axis)
+{
+    unsigned int seq;
+
+    do {
+        seq = read_seqbegin(&sensor->axis_lock);
+        *axis = sensor->axis;
+    } while (read_seqretry(&sensor->axis_lock, seq));
+}
+
+static void sensor_get_quat(struct sensor_private_data *sensor, struct sensor_quat *quat)
+{
+    unsigned int seq;
+
+    do {
+        seq = read_seqbegin(&sensor->axis_lock);
+        *quat = sensor->quat;
+    } while (read_seqretry(&sensor->axis_lock, seq));
+}
+
+static int sensor_ring_empty(struct sensor_ring *ring, unsigned int seq)
+{
+    return smp_load_acquire(&ring->hdr->write_seq) == seq;
+}
+
+/* 延时直方图的桶，见 SENSOR_HIST_BUCKETS */
+static inline int sensor_hist_bucket(s64 ns)
+{
+    return ns <= 0 ? 0 : min(fls64(ns), SENSOR_HIST_BUCKETS - 1);
+}
+
+/**
+ * 由具体传感器驱动的 report 函数调用，发布一个新样本：
+ * 更新 GETDATA 使用的最新值，并写入样本环供 read()/poll() 使用。
+ * 同一传感器只有一个发布者（在 sensor_mutex 中调用），写 axis 时不会睡眠，也不会等待读者。
+ */
+void jason_sensor_publish(struct sensor_private_data *sensor,
+        const struct sensor_axis *axis, ktime_t timestamp)
+{
+    struct sensor_stats *stats;
+
+    write_seqlock(&sensor->axis_lock);
+    sensor->axis = *axis;
+    write_sequnlock(&sensor->axis_lock);
+
+    sensor_ring_push(&sensor->ring, axis, timestamp);
+    trace_jason_sensor_publish(sensor, sensor->ring.hdr->write_seq - 1, timestamp);
+
+    stats = get_cpu_ptr(sensor->stats);
+    stats->samples++;
+    stats->latency_hist[sensor_hist_bucket(ktime_to_ns(ktime_sub(ktime_get_boottime(), timestamp)))]++;
+    put_cpu_ptr(sensor->stats);
+}
+EXPORT_SYMBOL(jason_sensor_publish);
+
+/* 角度传感器在 jason_sensor_publish 之前调用，更新 GET_QUAT 使用的最新四元数（Q30） */
+void jason_sensor_publish_quat(struct sensor_private_data *sensor,
+        const int *q, ktime_t timestamp)
+{
+    write_seqlock(&sensor->axis_lock);
+    sensor->quat.timestamp = ktime_to_ns(timestamp);
+    memcpy(sensor->quat.q, q, sizeof(sensor->quat.q));
+    write_sequnlock(&sensor->axis_lock);
+}
+EXPORT_SYMBOL(jason_sensor_publish_quat);
+
+/**
+ * 由具体传感器驱动在每次 i2c 读传输之后调用，start 为传输开始时的 ktime_get()，ret 小于 0 表示失败。
+ * 计数记在主设备上。
+ */
+void jason_sensor_stat_i2c(struct sensor_private_data *sensor, ktime_t start, int ret)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+    struct sensor_stats *stats;
+
+    stats = get_cpu_ptr(master->stats);
+    stats->i2c_xfers++;
+    if (ret < 0)
+        stats->i2c_errors++;
+    stats->i2c_hist[sensor_hist_bucket(ktime_to_ns(ktime_sub(ktime_get(), start)))]++;
+    put_cpu_ptr(master->stats);
+}
+EXPORT_SYMBOL(jason_sensor_stat_i2c);
+
+/**
+ * 代替 input_sync，把样本的采集时刻（CLOCK_BOOTTIME）带给 input 事件：
+ * MSC_TIMESTAMP 为微秒计数（32 位，会回绕），5.6 及之后的内核同时设置 evdev 事件的时间戳。
+ */
+void jason_sensor_input_sync(struct sensor_private_data *sensor, ktime_t timestamp)
+{
+    struct input_dev *input_dev = sensor->input_dev;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+    /* input_set_timestamp 使用 CLOCK_MONOTONIC */
+    input_set_timestamp(input_dev, ktime_sub(timestamp,
+        ktime_sub(ktime_get_boottime(), ktime_get())));
+#endif
+    input_event(input_dev, EV_MSC, MSC_TIMESTAMP, (u32)ktime_to_us(timestamp));
+    input_sync(input_dev);
+    trace_jason_sensor_report(sensor, timestamp);
+}
+EXPORT_SYMBOL(jason_sensor_input_sync);
+
+/**
+ * 上报一个芯片检测到的事件（SENSOR_EVENT_*），在采集路径中调用。
+ */
+void jason_sensor_report_event(struct sensor_private_data *sensor,
+            unsigned int event, ktime_t timestamp)
+{
+    input_event(sensor->input_dev, EV_MSC, MSC_GESTURE, event);
+    jason_sensor_input_sync(sensor, timestamp);
+}
+EXPORT_SYMBOL(jason_sensor_report_event);
+
+/*
+ * 加速度计和陀螺仪的校准参数保存在 vendor storage 的 SENSOR_CALIBRATION_ID 条目中，
+ * 开机后不需要重新校准。只保存每种类型的第一个实例。
+ */
+#ifndef SENSOR_CALIBRATION_ID
+#define SENSOR_CALIBRATION_ID	13
+#endif
+#define SENSOR_CALIB_MAGIC	0x4a534331	/* "JSC1" */
+#define SENSOR_TCOMP_VALID(slot)	BIT(8 + (slot))
+
+enum {
+    SENSOR_CALIB_SLOT_ACCEL,
+    SENSOR_CALIB_SLOT_GYRO,
+    SENSOR_CALIB_SLOT_NUM,
+};
+
+struct sensor_calib_store {
+    u32 magic;
+    u32 valid;			/* 按槽位标记哪些校准有效，温度补偿表使用 SENSOR_TCOMP_VALID */
+    struct sensor_calib calib[SENSOR_CALIB_SLOT_NUM];
+    struct sensor_tcomp tcomp[SENSOR_CALIB_SLOT_NUM];	/* 后来增加，旧的条目没有这一部分 */
+};
+
+/* 加速度计和陀螺仪共用一个条目，写入时需要先读出另一个的校准 */
+static DEFINE_MUTEX(sensor_calib_mutex);
+
+static int sensor_calib_slot(struct sensor_private_data *sensor)
+{
+    if (sensor->index)
+        return -1;
+
+    switch (sensor->type) {
+    case SENSOR_TYPE_ACCEL:
+        return SENSOR_CALIB_SLOT_ACCEL;
+    case SENSOR_TYPE_GYROSCOPE:
+        return SENSOR_CALIB_SLOT_GYRO;
+    default:
+        return -1;
+    }
+}
+
+static int sensor_calib_valid(const struct sensor_calib *calib)
+{
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (calib->scale[i] <= 0 || calib->scale[i] > SENSOR_CALIB_SCALE_MAX)
+            return 0;
+        if (calib->bias[i] < -32768 || calib->bias[i] > 32767)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int sensor_tcomp_valid(const struct sensor_tcomp *tcomp)
+{
+    int i, j;
+
+    if (tcomp->count < 0 || tcomp->count > SENSOR_TCOMP_POINTS)
+        return 0;
+
+    for (i = 0; i < tcomp->count; i++) {
+        if (i > 0 && tcomp->temp[i] <= tcomp->temp[i - 1])
+            return 0;
+        for (j = 0; j < 3; j++) {
+            if (tcomp->bias[i][j] < -32768 || tcomp->bias[i][j] > 32767)
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* 按温度在补偿表中线性插值，得到芯片坐标系下的额外零偏 */
+static void sensor_tcomp_bias(const struct sensor_tcomp *tcomp, int temp_mdeg, int *bias)
+{
+    const int *lo, *hi;
+    int i, k;
+
+    if (tcomp->count == 0) {
+        bias[0] = bias[1] = bias[2] = 0;
+        return;
+    }
+    if (temp_mdeg <= tcomp->temp[0] || tcomp->count == 1) {
+        memcpy(bias, tcomp->bias[0], sizeof(tcomp->bias[0]));
+        return;
+    }
+    if (temp_mdeg >= tcomp->temp[tcomp->count - 1]) {
+        memcpy(bias, tcomp->bias[tcomp->count - 1], sizeof(tcomp->bias[0]));
+        return;
+    }
+
+    for (k = 1; temp_mdeg > tcomp->temp[k]; k++)
+        ;
+    lo = tcomp->bias[k - 1];
+    hi = tcomp->bias[k];
+    for (i = 0; i < 3; i++)
+        bias[i] = lo[i] + (int)div_s64((s64)(hi[i] - lo[i]) * (temp_mdeg - tcomp->temp[k - 1]),
+            tcomp->temp[k] - tcomp->temp[k - 1]);
+}
+
+/**
+ * 把校准参数、layout 和单位换算合并成每个输出轴的一组系数。
+ * 调用者需持有主设备的 sensor_mutex（初始化时除外），与 report 互斥。
+ */
+static void sensor_update_xform(struct sensor_private_data *sensor)
+{
+    const signed char *m = sensor->pdata->orientation;
+    struct sensor_xform *xf = &sensor->xform;
+    s64 gain;
+    int i, j;
+
+    for (i = 0; i < 3; i++) {
+        /* 每行只有一个非零元素 */
+        for (j = 0; j < 2 && !m[i * 3 + j]; j++)
+            ;
+        gain = sensor->calib.scale[j];
+        if (sensor->pdata->si_units && sensor->scale_nano)
+            gain = div_s64(gain * sensor->scale_nano, 1000);
+        xf->src[i] = j;
+        xf->bias[i] = sensor->calib.bias[j] + sensor->tbias[j];
+        xf->gain[i] = m[i * 3 + j] < 0 ? -gain : gain;
+    }
+}
+
+static void sensor_calib_apply(struct sensor_private_data *sensor,
+        const struct sensor_calib *calib)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+
+    mutex_lock(&master->sensor_mutex);
+    sensor->calib = *calib;
+    sensor_update_xform(sensor);
+    mutex_unlock(&master->sensor_mutex);
+}
+
+/* 换了补偿表后，下一个样本按当前温度重新插值 */
+static void sensor_tcomp_apply(struct sensor_private_data *sensor,
+        const struct sensor_tcomp *tcomp)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+
+    mutex_lock(&master->sensor_mutex);
+    sensor->tcomp = *tcomp;
+    sensor_tcomp_bias(&sensor->tcomp, sensor->temp_mdeg, sensor->tbias);
+    sensor_update_xform(sensor);
+    mutex_unlock(&master->sensor_mutex);
+}
+
+/*
+ * 读出保存的条目，没有或无效时初始化为空条目。
+ * 旧的条目只有 calib 部分，此时温度补偿表为空。调用者需持有 sensor_calib_mutex。
+ */
+static void sensor_calib_read_store(struct sensor_calib_store *store)
+{
+    int ret;
+
+    ret = rk_vendor_read(SENSOR_CALIBRATION_ID, store, sizeof(*store));
+    if (ret < (int)offsetof(struct sensor_calib_store, tcomp) ||
+        store->magic != SENSOR_CALIB_MAGIC) {
+        memset(store, 0, sizeof(*store));
+        store->magic = SENSOR_CALIB_MAGIC;
+    } else if (ret < (int)sizeof(*store)) {
+        memset(store->tcomp, 0, sizeof(store->tcomp));
+        store->valid &= ~(SENSOR_TCOMP_VALID(SENSOR_CALIB_SLOT_ACCEL) |
+            SENSOR_TCOMP_VALID(SENSOR_CALIB_SLOT_GYRO));
+    }
+}
+
+/* 打开传感器时读取保存的校准和温度补偿表，vendor storage 还没有准备好时下次打开再试 */
+static void sensor_calib_load(struct sensor_private_data *sensor)
+{
+    struct i2c_client *client = sensor->client;
+    struct sensor_calib_store *store;
+    int slot = sensor_calib_slot(sensor);
+
+    if (slot < 0 || sensor->calib_loaded || !is_rk_vendor_ready())
+        return;
+    sensor->calib_loaded = 1;
+
+    store = kmalloc(sizeof(*store), GFP_KERNEL);
+    if (!store)
+        return;
+
+    mutex_lock(&sensor_calib_mutex);
+    sensor_calib_read_store(store);
+    mutex_unlock(&sensor_calib_mutex);
+
+    if (store->valid & BIT(slot)) {
+        if (sensor_calib_valid(&store->calib[slot])) {
+            sensor_calib_apply(sensor, &store->calib[slot]);
+            dev_info(&client->dev, "calibration loaded, bias %d %d %d\n",
+                store->calib[slot].bias[0], store->calib[slot].bias[1], store->calib[slot].bias[2]);
+        } else {
+            dev_warn(&client->dev, "%s: ignore invalid calibration\n", __func__);
+        }
+    }
+
+    if (store->valid & SENSOR_TCOMP_VALID(slot)) {
+        if (sensor_tcomp_valid(&store->tcomp[slot])) {
+            sensor_tcomp_apply(sensor, &store->tcomp[slot]);
+            dev_info(&client->dev, "temperature compensation loaded, %d points\n",
+                store->tcomp[slot].count);
+        } else {
+            dev_warn(&client->dev, "%s: ignore invalid temperature compensation\n", __func__);
+        }
+    }
+
+    kfree(store);
+}
+
+/* 保存当前的校准和温度补偿表，条目中另一种传感器的部分保持不变 */
+static int sensor_calib_save(struct sensor_private_data *sensor)
+{
+    struct sensor_calib_store *store;
+    int slot = sensor_calib_slot(sensor);
+    int ret;
+
+    if (slot < 0)
+        return -EOPNOTSUPP;
+    if (!is_rk_vendor_ready())
+        return -EAGAIN;
+
+    store = kmalloc(sizeof(*store), GFP_KERNEL);
+    if (!store)
+        return -ENOMEM;
+
+    mutex_lock(&sensor_calib_mutex);
+    sensor_calib_read_store(store);
+    store->calib[slot] = sensor->calib;
+    store->valid |= BIT(slot);
+    store->tcomp[slot] = sensor->tcomp;
+    if (sensor->tcomp.count)
+        store->valid |= SENSOR_TCOMP_VALID(slot);
+    else
+        store->valid &= ~SENSOR_TCOMP_VALID(slot);
+    ret = rk_vendor_write(SENSOR_CALIBRATION_ID, store, sizeof(*store));
+    mutex_unlock(&sensor_calib_mutex);
+
+    kfree(store);
+
+    return ret < 0 ? -EIO : 0;
+}
+
+/**
+ * 由 report 函数调用，把芯片输出的三个小端 16 位补码转换为上报值：
+ * 符号扩展、减去零偏、乘以增益（含校准、方向和单位换算），每个轴一次乘法。
+ * 调用者需持有主设备的 sensor_mutex。
+ */
+void jason_sensor_convert(struct sensor_private_data *sensor,
+        const uint8_t *buf, struct sensor_axis *axis)
+{
+    const struct sensor_xform *xf = &sensor->xform;
+    int raw[3], out[3];
+    int i;
+
+    raw[0] = (s16)get_unaligned_le16(buf);
+    raw[1] = (s16)get_unaligned_le16(buf + 2);
+    raw[2] = (s16)get_unaligned_le16(buf + 4);
+
+    for (i = 0; i < 3; i++)
+        out[i] = (int)(((s64)(raw[xf->src[i]] - xf->bias[i]) * xf->gain[i] +
+            (SENSOR_CALIB_ONE >> 1)) >> 16);
+
+    axis->x = out[0];
+    axis->y = out[1];
+    axis->z = out[2];
+    trace_jason_sensor_transform(sensor, raw, axis);
+}
+EXPORT_SYMBOL(jason_sensor_convert);
+
+/**
+ * 由 report 函数在转换之前调用，传入本次采样的芯片温度（0.001°C）。
+ * 有温度补偿表时按温度更新零偏，温度不变时不重新计算。
+ * 调用者需持有主设备的 sensor_mutex。
+ */
+void jason_sensor_set_temperature(struct sensor_private_data *sensor, int temp_mdeg)
+{
+    struct sensor_xform *xf = &sensor->xform;
+    int i;
+
+    if (!sensor->tcomp.count || temp_mdeg == sensor->temp_mdeg)
+        return;
+
+    sensor->temp_mdeg = temp_mdeg;
+    sensor_tcomp_bias(&sensor->tcomp, temp_mdeg, sensor->tbias);
+    for (i = 0; i < 3; i++)
+        xf->bias[i] = sensor->calib.bias[xf->src[i]] + sensor->tbias[xf->src[i]];
+}
+EXPORT_SYMBOL(jason_sensor_set_temperature);
+
+/* si_units 打开时 input 设备的范围跟随量程 */
+static void sensor_update_abs_range(struct sensor_private_data *sensor)
+{
+    unsigned int code;
+    int min = sensor->ops->range[0];
+    int max = sensor->ops->range[1];
+    int i;
+
+    if (sensor->type == SENSOR_TYPE_ACCEL)
+        code = ABS_X;
+    else if (sensor->type == SENSOR_TYPE_GYROSCOPE)
+        code = ABS_RX;
+    else
+        return;
+
+    if (sensor->pdata->si_units && sensor->scale_nano) {
+        min = div_s64((s64)min * sensor->scale_nano, 1000);
+        max = div_s64((s64)max * sensor->scale_nano, 1000);
+    }
+
+    for (i = 0; i < 3; i++)
+        input_set_abs_params(sensor->input_dev, code + i, min, max, 0, 0);
+}
+
+/**
+ * 由具体传感器驱动在配置量程后调用，设置 1 LSB 对应的 SI 单位大小，
+ * 单位为 n m/s^2（加速度计）或 n rad/s（陀螺仪）。设备树打开 si_units 时上报值按此换算。
+ */
+void jason_sensor_set_scale(struct sensor_private_data *sensor, int scale_nano)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+
+    mutex_lock(&master->sensor_mutex);
+    sensor->scale_nano = scale_nano;
+    sensor_update_xform(sensor);
+    mutex_unlock(&master->sensor_mutex);
+
+    if (sensor->input_dev)
+        sensor_update_abs_range(sensor);
+}
+EXPORT_SYMBOL(jason_sensor_set_scale);
+
+/**
+ * 按 period_ns 降频：判断 timestamp 的样本是否需要交出，需要时推进 *next。
+ * 允许提前四分之一个周期，避免采样时刻的抖动多丢一个样本；period_ns 不大于 0 时不降频。
+ */
+int jason_sensor_due(ktime_t *next, s64 period_ns, ktime_t timestamp)
+{
+    ktime_t due;
+
+    if (period_ns <= 0)
+        return 1;
+
+    if (ktime_to_ns(ktime_sub(*next, timestamp)) > period_ns / 4)
+        return 0;
+
+    /* 第一个样本或落后超过一个周期时，从本样本重新开始计时 */
+    due = ktime_add_ns(*next, period_ns);
+    if (ktime_before(due, timestamp))
+        due = ktime_add_ns(timestamp, period_ns);
+    *next = due;
+
+    return 1;
+}
+EXPORT_SYMBOL(jason_sensor_due);
+
+/**
+ * 主设备的采样比该功能请求的周期快时，由具体传感器驱动在上报前调用，判断本样本是否需要上报。
+ * 调用者需持有主设备的 sensor_mutex。
+ */
+int jason_sensor_sample_due(struct sensor_private_data *sensor, ktime_t timestamp)
+{
+    return jason_sensor_due(&sensor->next_report, (s64)sensor->period_us * NSEC_PER_USEC, timestamp);
+}
+EXPORT_SYMBOL(jason_sensor_sample_due);
 
 /* 获取芯片ID */
 static int sensor_get_id(struct i2c_client *client, int *value)
@@ -75,11 +704,11 @@ static int sensor_initial(struct i2c_client *client)
 
 /**
  * 检查传感器芯片是否可用，并对芯片进行初始化。
+ * ops 由芯片驱动在注册时传入，保存在各自实例的 sensor->ops 中，多个实例之间互不影响。
  */
-static int sensor_chip_init(struct i2c_client *client)
+static int sensor_chip_init(struct i2c_client *client, struct sensor_operate *ops)
 {
     struct sensor_private_data *sensor = (struct sensor_private_data *) i2c_get_clientdata(client);
-    struct sensor_operate *ops = sensor_ops[(int)sensor->i2c_id->driver_data];
     int result = 0;
 
     if (ops) {
@@ -123,63 +752,171 @@ error:
     return result;
 }
 
+/* 开始轮询：第一次采集立即进行，之后每个周期由 poll_timer 触发 */
+static void sensor_poll_start(struct sensor_private_data *sensor)
+{
+    sensor->stop_work = 0;
+    kthread_queue_work(sensor->worker, &sensor->poll_work);
+    hrtimer_start(&sensor->poll_timer, ktime_add(ktime_get(), sensor->poll_period), HRTIMER_MODE_ABS);
+}
+
+static void sensor_poll_stop(struct sensor_private_data *sensor)
+{
+    sensor->stop_work = 1;
+    hrtimer_cancel(&sensor->poll_timer);
+    kthread_cancel_work_sync(&sensor->poll_work);
+}
+
 /**
- * 重新设置延迟工作队列的延迟时间
+ * 主设备按已打开的功能（主设备和从设备）以及其他数据通道（acq_period_us）中最短的上报周期轮询，
+ * 其余功能由 jason_sensor_sample_due 降频。
+ * 轮询运行中只修改周期，hrtimer 下次前移时生效，不停止采集；周期变短时重新设置下一次到期时刻。
+ * 调用者需持有主设备的 operation_mutex。
  */
-static int sensor_reset_rate(struct i2c_client *client, int rate)
+static void sensor_update_poll(struct sensor_private_data *master)
 {
-    struct sensor_private_data *sensor = (struct sensor_private_data *) i2c_get_clientdata(client);
+    struct sensor_private_data *companion;
+    int period_us = INT_MAX;
+    ktime_t period;
+
+    if (master->status_cur == SENSOR_ON)
+        period_us = master->period_us;
+    list_for_each_entry(companion, &master->companions, companion_node) {
+        if (companion->status_cur == SENSOR_ON)
+            period_us = min(period_us, companion->period_us);
+    }
+    if (master->acq_period_us > 0)
+        period_us = min(period_us, master->acq_period_us);
+    if (period_us == INT_MAX)
+        period_us = master->period_us;
+
+    if (master->pdata->irq_enable || period_us <= 0 ||
+        period_us == master->pdata->poll_period_us)
+        return;
+
+    period = ns_to_ktime((u64)period_us * NSEC_PER_USEC);
+    master->pdata->poll_period_us = period_us;
+    master->pdata->poll_delay_ms = DIV_ROUND_UP(period_us, USEC_PER_MSEC);
+    if (master->acq_count > 0 && ktime_before(period, master->poll_period))
+        hrtimer_start(&master->poll_timer, ktime_add(ktime_get(), period), HRTIMER_MODE_ABS);
+    master->poll_period = period;
+
+    dev_info(&master->client->dev, "poll period %dus\n", period_us);
+}
+
+/**
+ * 设置上报周期，单位：us，最高 1kHz。芯片的输出数据率和主设备的轮询周期随之调整，采集不会中断。
+ */
+static int sensor_set_period(struct sensor_private_data *sensor, unsigned int period_us)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+    struct i2c_client *client = master->client;
     int result = 0;
 
-    if (rate < 5)
-        rate = 5;
-    else if (rate > 200)
-        rate = 200;
+    period_us = clamp_t(unsigned int, period_us, SENSOR_POLL_PERIOD_MIN_US, SENSOR_POLL_PERIOD_MAX_US);
 
-    dev_info(&client->dev, "set sensor poll time to %dms\n", rate);
+    dev_info(&client->dev, "set %s period to %uus\n", sensor->ops->name, period_us);
 
-    /* work queue is always slow, we need more quickly to match hal rate */
-    if (sensor->pdata->poll_delay_ms == (rate - 4))
+    if (sensor->period_us == period_us)
         return 0;
 
-    sensor->pdata->poll_delay_ms = rate - 4;
+    if (sensor != master)
+        mutex_lock_nested(&master->operation_mutex, SINGLE_DEPTH_NESTING);
 
-    if (sensor->status_cur == SENSOR_ON) {
-        if (!sensor->pdata->irq_enable) {
-            sensor->stop_work = 1;
-            cancel_delayed_work_sync(&sensor->delaywork);
-        }
-        sensor->ops->active(client, SENSOR_OFF, rate);
-        result = sensor->ops->active(client, SENSOR_ON, rate);
-        if (!sensor->pdata->irq_enable) {
-            sensor->stop_work = 0;
-            schedule_delayed_work(&sensor->delaywork, msecs_to_jiffies(sensor->pdata->poll_delay_ms));
-        }
-    }
+    sensor->period_us = period_us;
+    if (sensor->ops->set_rate)
+        result = sensor->ops->set_rate(sensor, period_us);
+    sensor_update_poll(master);
+
+    if (sensor != master)
+        mutex_unlock(&master->operation_mutex);
 
     return result;
 }
 
 /**
- * 延迟工作函数，执行周期：sensor->pdata->poll_delay_ms
+ * 重新设置轮询周期，单位：ms
+ */
+static int sensor_reset_rate(struct sensor_private_data *sensor, int rate)
+{
+    if (rate < 1)
+        rate = 1;
+    else if (rate > SENSOR_POLL_PERIOD_MAX_US / USEC_PER_MSEC)
+        rate = SENSOR_POLL_PERIOD_MAX_US / USEC_PER_MSEC;
+
+    return sensor_set_period(sensor, rate * USEC_PER_MSEC);
+}
+
+/**
+ * 轮询定时器，按绝对时间推进到期时间，周期不受回调延迟影响，不会累积漂移。
+ * 定时器运行在中断上下文，i2c 读取交给采集线程中的 poll_work 完成。
+ */
+static enum hrtimer_restart sensor_poll_timer_func(struct hrtimer *timer)
+{
+    struct sensor_private_data *sensor = container_of(timer, struct sensor_private_data, poll_timer);
+    u64 overruns;
+
+    /* 回调被推迟超过一个周期时，跳过的周期记为错过 */
+    overruns = hrtimer_forward_now(timer, sensor->poll_period);
+    if (overruns > 1)
+        atomic_add(overruns - 1, &sensor->poll_missed);
+
+    /* 上一个周期的读取还没有完成，本周期的采集被丢弃 */
+    if (!kthread_queue_work(sensor->worker, &sensor->poll_work))
+        atomic_inc(&sensor->poll_missed);
+    else
+        trace_jason_sensor_schedule(sensor, sensor->acq_seq + 1);
+
+    return HRTIMER_RESTART;
+}
+
+/**
+ * 轮询工作函数，执行周期：sensor->poll_period
  */
-static void  sensor_delaywork_func(struct work_struct *work)
+static void sensor_poll_work_func(struct kthread_work *work)
 {
-    struct delayed_work *delaywork = container_of(work, struct delayed_work, work);
-    struct sensor_private_data *sensor = container_of(delaywork, struct sensor_private_data, delaywork);
+    struct sensor_private_data *sensor = container_of(work, struct sensor_private_data, poll_work);
     struct i2c_client *client = sensor->client;
+    int missed;
     int result;
 
+    if (sensor->stop_work)
+        return;
+
+    /* 采集序号只在采集线程（或中断线程）中修改，两者不会同时存在 */
+    trace_jason_sensor_wakeup(sensor, ++sensor->acq_seq);
+
     mutex_lock(&sensor->sensor_mutex);
+    sensor->timestamp = ktime_get_boottime();
     result = sensor->ops->report(client);
     if (result < 0)
         dev_err(&client->dev, "%s: Get data failed\n", __func__);
     mutex_unlock(&sensor->sensor_mutex);
 
-    if ((!sensor->pdata->irq_enable) && (sensor->stop_work == 0))
-        schedule_delayed_work(&sensor->delaywork, msecs_to_jiffies(sensor->pdata->poll_delay_ms));
+    missed = atomic_read(&sensor->poll_missed);
+    if (missed != sensor->poll_missed_reported) {
+        dev_warn_ratelimited(&client->dev, "%s: %d poll deadlines missed, period %lldus\n",
+            __func__, missed, ktime_to_us(sensor->poll_period));
+        sensor->poll_missed_reported = missed;
+    }
 }
  
+/*
+ * 中断上半部：只记录中断到来的时间，读取数据在线程中完成。
+ * 线程中的 i2c 传输可能被调度延迟，用这里的时间戳才能反映芯片真正的采样时刻。
+ * 使用 IRQF_ONESHOT，线程处理完之前中断不会再次触发，irq_timestamp 不会被覆盖。
+ */
+static irqreturn_t sensor_irq_top(int irq, void *dev_id)
+{
+    struct sensor_private_data *sensor =
+            (struct sensor_private_data *)dev_id;
+
+    sensor->irq_timestamp = ktime_get_boottime();
+    trace_jason_sensor_schedule(sensor, sensor->acq_seq + 1);
+
+    return IRQ_WAKE_THREAD;
+}
+
  /*
   * This is a threaded IRQ handler so can access I2C/SPI.  Since all
   * interrupts are clear on read the IRQ line will be reasserted and
@@ -195,8 +932,10 @@ static void  sensor_delaywork_func(struct work_struct *work)
              (struct sensor_private_data *)dev_id;
      struct i2c_client *client = sensor->client;
  
+     trace_jason_sensor_wakeup(sensor, ++sensor->acq_seq);
      mutex_lock(&sensor->sensor_mutex);
      pm_stay_awake(&client->dev);
+     sensor->timestamp = sensor->irq_timestamp;
      if (sensor->ops->report(client) < 0)
          dev_err(&client->dev, "%s: Get data failed\n", __func__);
      pm_relax(&client->dev);
@@ -205,8 +944,61 @@ static void  sensor_delaywork_func(struct work_struct *work)
      return IRQ_HANDLED;
  }
 
+static void sensor_worker_destroy(void *data)
+{
+    kthread_destroy_worker(data);
+}
+
+/**
+ * 创建传感器独立的采集线程，按设备树中的 rt_priority、cpu_affinity 设置调度策略和 CPU 亲和性。
+ */
+static int sensor_worker_init(struct sensor_private_data *sensor)
+{
+    struct i2c_client *client = sensor->client;
+    struct sensor_platform_data *pdata = sensor->pdata;
+    struct kthread_worker *worker;
+    struct sched_param param = { .sched_priority = pdata->rt_priority };
+    int result;
+
+    if (pdata->cpu_affinity >= 0 &&
+        (pdata->cpu_affinity >= nr_cpu_ids || !cpu_online(pdata->cpu_affinity))) {
+        dev_warn(&client->dev, "%s:cpu %d is not available, not bound\n", __func__, pdata->cpu_affinity);
+        pdata->cpu_affinity = -1;
+    }
+
+    if (pdata->cpu_affinity >= 0)
+        worker = kthread_create_worker_on_cpu(pdata->cpu_affinity, 0, "sensor/%s", sensor->ops->name);
+    else
+        worker = kthread_create_worker(0, "sensor/%s", sensor->ops->name);
+    if (IS_ERR(worker))
+        return PTR_ERR(worker);
+
+    result = devm_add_action_or_reset(&client->dev, sensor_worker_destroy, worker);
+    if (result)
+        return result;
+
+    if (pdata->rt_priority > 0) {
+        if (pdata->rt_priority >= MAX_RT_PRIO)
+            param.sched_priority = MAX_RT_PRIO - 1;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+        /* 5.9 之后不再导出 sched_setscheduler_nocheck，只能使用默认的 RT 优先级 */
+        sched_set_fifo(worker->task);
+#else
+        result = sched_setscheduler_nocheck(worker->task, SCHED_FIFO, &param);
+        if (result)
+            dev_warn(&client->dev, "%s:fail to set SCHED_FIFO %d,ret=%d\n", __func__, param.sched_priority, result);
+#endif
+    }
+
+    sensor->worker = worker;
+    dev_info(&client->dev, "%s:worker %s, rt_priority=%d, cpu=%d\n", __func__,
+        sensor->ops->name, pdata->rt_priority, pdata->cpu_affinity);
+
+    return 0;
+}
+
 /**
- * 中断或延迟工作任务初始化
+ * 中断或轮询采集初始化
  */
 static int sensor_irq_init(struct i2c_client *client)
 {
@@ -223,7 +1015,7 @@ static int sensor_irq_init(struct i2c_client *client)
             dev_err(&client->dev, "%s:fail to request gpio :%d\n", __func__, client->irq);
 
         irq = gpio_to_irq(client->irq);
-        result = devm_request_threaded_irq(&client->dev, irq, NULL, sensor_interrupt, sensor->pdata->irq_flags | IRQF_ONESHOT, sensor->ops->name, sensor);
+        result = devm_request_threaded_irq(&client->dev, irq, sensor_irq_top, sensor_interrupt, sensor->pdata->irq_flags | IRQF_ONESHOT, sensor->ops->name, sensor);
         if (result) {
             dev_err(&client->dev, "%s:fail to request irq = %d, ret = 0x%x\n", __func__, irq, result);
             goto error;
@@ -235,14 +1027,29 @@ static int sensor_irq_init(struct i2c_client *client)
     }
 
     if (!sensor->pdata->irq_enable) {
-        // 初始化 工作函数
-        INIT_DELAYED_WORK(&sensor->delaywork, sensor_delaywork_func);
+        // 初始化采集线程、轮询定时器和工作函数
+        result = sensor_worker_init(sensor);
+        if (result) {
+            dev_err(&client->dev, "%s:fail to create worker,ret=%d\n", __func__, result);
+            goto error;
+        }
+        kthread_init_work(&sensor->poll_work, sensor_poll_work_func);
+        hrtimer_init(&sensor->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+        sensor->poll_timer.function = sensor_poll_timer_func;
+        atomic_set(&sensor->poll_missed, 0);
         sensor->stop_work = 1;
         if (sensor->pdata->poll_delay_ms <= 0)
             sensor->pdata->poll_delay_ms = 30;
-
-        dev_info(&client->dev, "%s:use polling, delay=%d ms\n", __func__, sensor->pdata->poll_delay_ms);
+        if (sensor->pdata->poll_period_us <= 0)
+            sensor->pdata->poll_period_us = sensor->pdata->poll_delay_ms * USEC_PER_MSEC;
+        sensor->pdata->poll_period_us = clamp_t(int, sensor->pdata->poll_period_us,
+            SENSOR_POLL_PERIOD_MIN_US, SENSOR_POLL_PERIOD_MAX_US);
+        sensor->pdata->poll_delay_ms = DIV_ROUND_UP(sensor->pdata->poll_period_us, USEC_PER_MSEC);
+        sensor->poll_period = ns_to_ktime((u64)sensor->pdata->poll_period_us * NSEC_PER_USEC);
+
+        dev_info(&client->dev, "%s:use polling, period=%d us\n", __func__, sensor->pdata->poll_period_us);
     }
+    sensor->period_us = sensor->pdata->poll_period_us;
 
 error:
     return result;
@@ -254,60 +1061,599 @@ void jason_sensor_shutdown(struct i2c_client *client)
 }
 EXPORT_SYMBOL(jason_sensor_shutdown);
  
-static int sensor_enable(struct sensor_private_data *sensor, int enable)
+/**
+ * 启动或停止主设备的采集。主设备和它的从设备中只要有一个处于打开状态，采集就保持运行，
+ * 调用者需持有主设备的 operation_mutex。
+ */
+static int sensor_acquire(struct sensor_private_data *master, int enable)
 {
     int result = 0;
-    struct i2c_client *client = sensor->client;
+    struct i2c_client *client = master->client;
 
     if (enable == SENSOR_ON) {
-        result = sensor->ops->active(client, 1, sensor->pdata->poll_delay_ms);
+        if (master->acq_count++ > 0)
+            goto notify;
+        /* 芯片可能已经 autosuspend，先唤醒再打开 */
+        result = pm_runtime_get_sync(&client->dev);
+        if (result < 0) {
+            dev_err(&client->dev, "%s:fail to resume sensor,ret=%d\n", __func__, result);
+            pm_runtime_put_noidle(&client->dev);
+            master->acq_count--;
+            return result;
+        }
+        result = master->ops->active(client, 1, master->pdata->poll_delay_ms);
         if (result < 0) {
             dev_err(&client->dev, "%s:fail to active sensor,ret=%d\n", __func__, result);
+            pm_runtime_put_autosuspend(&client->dev);
+            master->acq_count--;
             return result;
         }
-        sensor->status_cur = SENSOR_ON;
-        sensor->stop_work = 0;
-        if (sensor->pdata->irq_enable)
+        if (master->pdata->irq_enable) {
+            master->stop_work = 0;
             enable_irq(client->irq);
-        else
-            schedule_delayed_work(&sensor->delaywork, msecs_to_jiffies(sensor->pdata->poll_delay_ms));
-        dev_info(&client->dev, "sensor on: starting poll sensor data %dms\n", sensor->pdata->poll_delay_ms);
+        } else {
+            sensor_poll_start(master);
+        }
+        dev_info(&client->dev, "sensor on: starting poll sensor data %dus\n", master->pdata->poll_period_us);
     } else {
-        sensor->stop_work = 1;
-        if (sensor->pdata->irq_enable)
+        if (--master->acq_count > 0)
+            goto notify;
+        if (master->pdata->irq_enable) {
+            master->stop_work = 1;
             disable_irq_nosync(client->irq);
-        else
-            cancel_delayed_work_sync(&sensor->delaywork);
-        result = sensor->ops->active(client, 0, sensor->pdata->poll_delay_ms);
-        if (result < 0) {
+        } else {
+            sensor_poll_stop(master);
+        }
+        result = master->ops->active(client, 0, master->pdata->poll_delay_ms);
+        if (result < 0)
             dev_err(&client->dev, "%s:fail to disable sensor,ret=%d\n", __func__, result);
-            return result;
+        /* 很快再次打开时不必挂起和唤醒，延时到期后才进入低功耗 */
+        pm_runtime_mark_last_busy(&client->dev);
+        pm_runtime_put_autosuspend(&client->dev);
+        return result;
+    }
+
+notify:
+    /* 使用者变化后芯片可能需要打开或关闭数据中断 */
+    if (master->ops->set_events)
+        master->ops->set_events(master, master->events);
+
+    return result;
+}
+
+/**
+ * 供其他数据通道（例如 IIO）使用：不经过 misc/input 设备，直接启动或停止主设备的采集。
+ */
+int jason_sensor_acquire(struct sensor_private_data *sensor, int enable)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+    int result;
+
+    mutex_lock(&master->operation_mutex);
+    result = sensor_acquire(master, enable);
+    mutex_unlock(&master->operation_mutex);
+
+    return result;
+}
+EXPORT_SYMBOL(jason_sensor_acquire);
+
+/**
+ * 供其他数据通道设置它请求的轮询周期，单位：us，0 表示取消，轮询运行中修改立即生效。
+ * 主设备的轮询周期与 misc 设备请求的周期一起取最短的，中断模式下不影响采集。
+ */
+void jason_sensor_set_acquire_period(struct sensor_private_data *sensor, unsigned int period_us)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+
+    if (period_us)
+        period_us = clamp_t(unsigned int, period_us, SENSOR_POLL_PERIOD_MIN_US, SENSOR_POLL_PERIOD_MAX_US);
+
+    mutex_lock(&master->operation_mutex);
+    master->acq_period_us = period_us;
+    sensor_update_poll(master);
+    mutex_unlock(&master->operation_mutex);
+}
+EXPORT_SYMBOL(jason_sensor_set_acquire_period);
+
+/**
+ * 不启动采集、只临时访问芯片时（例如 IIO 的单次读取）唤醒芯片，用完后调用 jason_sensor_pm_put。
+ */
+int jason_sensor_pm_get(struct sensor_private_data *sensor)
+{
+    struct device *dev = &sensor_master(sensor)->client->dev;
+    int result;
+
+    result = pm_runtime_get_sync(dev);
+    if (result < 0) {
+        pm_runtime_put_noidle(dev);
+        return result;
+    }
+
+    return 0;
+}
+EXPORT_SYMBOL(jason_sensor_pm_get);
+
+void jason_sensor_pm_put(struct sensor_private_data *sensor)
+{
+    struct device *dev = &sensor_master(sensor)->client->dev;
+
+    pm_runtime_mark_last_busy(dev);
+    pm_runtime_put_autosuspend(dev);
+}
+EXPORT_SYMBOL(jason_sensor_pm_put);
+
+/*
+ * runtime PM 以主设备的 i2c client 为单位，主设备和从设备都关闭（acq_count 为 0）
+ * 并经过 autosuspend 延时后调用主设备的 ops->suspend，第一次打开时调用 ops->resume。
+ */
+static int sensor_runtime_suspend(struct device *dev)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *) i2c_get_clientdata(to_i2c_client(dev));
+
+    if (sensor->ops->suspend && sensor->ops->suspend(sensor->client) < 0) {
+        dev_err(dev, "%s: suspend failed\n", __func__);
+        return -EAGAIN;
+    }
+
+    return 0;
+}
+
+static int sensor_runtime_resume(struct device *dev)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *) i2c_get_clientdata(to_i2c_client(dev));
+    ktime_t start = ktime_get();
+
+    if (sensor->ops->resume && sensor->ops->resume(sensor->client) < 0) {
+        dev_err(dev, "%s: resume failed\n", __func__);
+        return -EIO;
+    }
+
+    /* 从 START 到芯片可以出数的延时，通过 resume_latency_us 查看 */
+    sensor->resume_latency_us = ktime_us_delta(ktime_get(), start);
+    sensor->resume_latency_max_us = max(sensor->resume_latency_max_us,
+        sensor->resume_latency_us);
+
+    return 0;
+}
+
+const struct dev_pm_ops jason_sensor_pm_ops = {
+    SET_RUNTIME_PM_OPS(sensor_runtime_suspend, sensor_runtime_resume, NULL)
+};
+EXPORT_SYMBOL(jason_sensor_pm_ops);
+
+static ssize_t resume_latency_us_show(struct device *dev,
+            struct device_attribute *attr, char *buf)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *) i2c_get_clientdata(to_i2c_client(dev));
+
+    return sprintf(buf, "%d %d\n", sensor->resume_latency_us, sensor->resume_latency_max_us);
+}
+static DEVICE_ATTR_RO(resume_latency_us);
+
+static struct attribute *sensor_pm_attrs[] = {
+    &dev_attr_resume_latency_us.attr,
+    NULL,
+};
+
+static const struct attribute_group sensor_pm_attr_group = {
+    .attrs = sensor_pm_attrs,
+};
+
+/**
+ * probe 完成时芯片处于工作状态，使能 runtime PM 后没有功能打开就会在延时后挂起。
+ */
+static int sensor_pm_init(struct sensor_private_data *sensor)
+{
+    struct device *dev = &sensor->client->dev;
+
+    pm_runtime_get_noresume(dev);
+    pm_runtime_set_active(dev);
+    pm_runtime_set_autosuspend_delay(dev, sensor->pdata->autosuspend_delay_ms);
+    pm_runtime_use_autosuspend(dev);
+    pm_runtime_enable(dev);
+    pm_runtime_mark_last_busy(dev);
+    pm_runtime_put_autosuspend(dev);
+
+    return devm_device_add_group(dev, &sensor_pm_attr_group);
+}
+
+static void sensor_pm_remove(struct sensor_private_data *sensor)
+{
+    struct device *dev = &sensor->client->dev;
+
+    pm_runtime_disable(dev);
+    pm_runtime_set_suspended(dev);
+    pm_runtime_dont_use_autosuspend(dev);
+}
+
+static int sensor_enable(struct sensor_private_data *sensor, int enable)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+    struct i2c_client *client = sensor->client;
+    int result = 0;
+
+    /* 从设备的 operation_mutex 已被持有，这里再持有主设备的，用于保护 acq_count */
+    if (sensor != master)
+        mutex_lock_nested(&master->operation_mutex, SINGLE_DEPTH_NESTING);
+
+    if (enable == SENSOR_ON) {
+        sensor_calib_load(sensor);
+        if (sensor != master && sensor->ops->active) {
+            result = sensor->ops->active(client, 1, master->pdata->poll_delay_ms);
+            if (result < 0)
+                goto out;
         }
+        if (sensor->ops->set_rate && sensor->period_us > 0)
+            sensor->ops->set_rate(sensor, sensor->period_us);
+        sensor->next_report = 0;
+        sensor->status_cur = SENSOR_ON;
+        sensor_update_poll(master);
+        result = sensor_acquire(master, SENSOR_ON);
+        if (result < 0)
+            sensor->status_cur = SENSOR_OFF;
+    } else {
         sensor->status_cur = SENSOR_OFF;
+        sensor_update_poll(master);
+        result = sensor_acquire(master, SENSOR_OFF);
+        if (sensor != master && sensor->ops->active)
+            sensor->ops->active(client, 0, master->pdata->poll_delay_ms);
     }
 
+out:
+    if (sensor != master)
+        mutex_unlock(&master->operation_mutex);
+
     return result;
 }
- 
 
-static int gsensor_dev_open(struct inode *inode, struct file *file)
+/**
+ * 打开 misc 设备。misc_open 已经把 file->private_data 设为对应的 miscdevice，
+ * 这里替换成记录读取位置的 sensor_file，新读者只读取打开之后产生的样本。
+ */
+static int sensor_dev_open(struct inode *inode, struct file *file)
 {
+    struct sensor_private_data *sensor =
+        container_of(file->private_data, struct sensor_private_data, miscdev);
+    struct sensor_file *sfile;
+
+    sfile = kzalloc(sizeof(*sfile), GFP_KERNEL);
+    if (!sfile)
+        return -ENOMEM;
+
+    sfile->sensor = sensor;
+    sfile->seq = smp_load_acquire(&sensor->ring.hdr->write_seq);
+    file->private_data = sfile;
+    atomic_inc(&sensor->readers);
+
+    /* 没有 pread/pwrite，llseek 用来设置样本环的读取位置，见 sensor_dev_llseek */
+    file->f_mode &= ~(FMODE_PREAD | FMODE_PWRITE);
+
     return 0;
 }
 
-static int gsensor_dev_release(struct inode *inode, struct file *file)
+/**
+ * 修改 sfile 使能的事件。各文件使能的事件取并集，使能了事件时占用一次采集，
+ * 只有事件没有数据使用者时芯片只在事件发生时产生中断。
+ */
+static long sensor_dev_set_events(struct sensor_file *sfile, unsigned int events)
 {
+    struct sensor_private_data *sensor = sfile->sensor;
+    unsigned int old, changed;
+    int i, result = 0;
+
+    if (!sensor->ops->set_events || sensor->master)
+        return -ENOTTY;
+    if (events & ~sensor->ops->events)
+        return -EINVAL;
+
+    mutex_lock(&sensor->operation_mutex);
+    old = sensor->events;
+    changed = sfile->events ^ events;
+    for (i = 0; i < SENSOR_EVENT_NUM; i++) {
+        if (!(changed & BIT(i)))
+            continue;
+        sensor->event_count[i] += (events & BIT(i)) ? 1 : -1;
+        if (sensor->event_count[i])
+            sensor->events |= BIT(i);
+        else
+            sensor->events &= ~BIT(i);
+    }
+
+    if (!old && sensor->events)
+        result = sensor_acquire(sensor, SENSOR_ON);
+    else if (old && !sensor->events)
+        result = sensor_acquire(sensor, SENSOR_OFF);
+    else if (old != sensor->events)
+        result = sensor->ops->set_events(sensor, sensor->events);
+
+    if (result < 0 && !old && sensor->events) {
+        /* 没能启动采集，撤销本次修改 */
+        for (i = 0; i < SENSOR_EVENT_NUM; i++) {
+            if (changed & BIT(i))
+                sensor->event_count[i] = 0;
+        }
+        sensor->events = 0;
+    } else {
+        sfile->events = events;
+    }
+    mutex_unlock(&sensor->operation_mutex);
+
+    return result;
+}
+
+static int sensor_dev_release(struct inode *inode, struct file *file)
+{
+    struct sensor_file *sfile = file->private_data;
+
+    if (sfile->events)
+        sensor_dev_set_events(sfile, 0);
+    atomic_dec(&sfile->sensor->readers);
+    kfree(sfile);
+    return 0;
+}
+
+/* 通过 sensor_dev_open 打开的文件对应的传感器实例 */
+static inline struct sensor_private_data *sensor_from_file(struct file *file)
+{
+    struct sensor_file *sfile = file->private_data;
+
+    return sfile->sensor;
+}
+
+/**
+ * 读取样本，每次返回整数个 struct sensor_sample。
+ * 没有新样本时阻塞，O_NONBLOCK 时返回 -EAGAIN。
+ */
+static ssize_t sensor_dev_read(struct file *file, char __user *buf,
+            size_t count, loff_t *ppos)
+{
+    struct sensor_file *sfile = file->private_data;
+    struct sensor_ring *ring = &sfile->sensor->ring;
+    struct sensor_sample sample;
+    size_t copied = 0;
+    int result;
+
+    if (count < sizeof(sample))
+        return -EINVAL;
+
+    if (sensor_ring_empty(ring, sfile->seq)) {
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        result = wait_event_interruptible(ring->wq, !sensor_ring_empty(ring, sfile->seq));
+        if (result)
+            return result;
+    }
+
+    while (copied + sizeof(sample) <= count) {
+        if (!sensor_ring_pop(ring, &sfile->seq, &sample, NULL))
+            break;
+        if (copy_to_user(buf + copied, &sample, sizeof(sample)))
+            return copied ? copied : -EFAULT;
+        copied += sizeof(sample);
+    }
+
+    return copied;
+}
+
+/**
+ * 批量读取样本（*_IOCTL_GET_BATCH），与 read() 共用同一个读取位置。
+ * 一次系统调用最多取出 batch.max 个样本，返回取出的个数和期间丢失的样本数。
+ */
+static long sensor_dev_get_batch(struct file *file, void __user *argp)
+{
+    struct sensor_file *sfile = file->private_data;
+    struct sensor_ring *ring = &sfile->sensor->ring;
+    struct sensor_sample __user *samples;
+    struct sensor_sample sample;
+    struct sensor_batch batch;
+    int result;
+
+    if (copy_from_user(&batch, argp, sizeof(batch)))
+        return -EFAULT;
+    if (batch.flags & ~SENSOR_BATCH_WAIT)
+        return -EINVAL;
+
+    samples = u64_to_user_ptr(batch.samples);
+    batch.count = 0;
+    batch.dropped = 0;
+
+    if ((batch.flags & SENSOR_BATCH_WAIT) && batch.max && sensor_ring_empty(ring, sfile->seq)) {
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        result = wait_event_interruptible(ring->wq, !sensor_ring_empty(ring, sfile->seq));
+        if (result)
+            return result;
+    }
+
+    while (batch.count < batch.max) {
+        if (!sensor_ring_pop(ring, &sfile->seq, &sample, &batch.dropped))
+            break;
+        if (copy_to_user(&samples[batch.count], &sample, sizeof(sample)))
+            return -EFAULT;
+        batch.count++;
+    }
+
+    if (copy_to_user(argp, &batch, sizeof(batch)))
+        return -EFAULT;
+
+    return 0;
+}
+
+/**
+ * 把样本环只读映射到用户态，映射布局见 struct sensor_ring_header。
+ */
+static int sensor_dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct sensor_file *sfile = file->private_data;
+    struct sensor_ring *ring = &sfile->sensor->ring;
+
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+    if (vma->vm_pgoff || vma->vm_end - vma->vm_start > ring->mmap_size)
+        return -EINVAL;
+
+    vma->vm_flags &= ~VM_MAYWRITE;
+    vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+    return remap_vmalloc_range(vma, ring->hdr, 0);
+}
+
+/**
+ * 设置本文件在样本环中的读取位置（样本序号），返回新的位置。
+ * SEEK_SET 为绝对序号，SEEK_CUR 相对当前位置，SEEK_END 相对 write_seq。
+ * 通过 mmap 读取的程序在 poll() 之前用它告诉驱动自己已经读到哪里。
+ */
+static loff_t sensor_dev_llseek(struct file *file, loff_t offset, int whence)
+{
+    struct sensor_file *sfile = file->private_data;
+    struct sensor_ring *ring = &sfile->sensor->ring;
+    unsigned int seq;
+
+    switch (whence) {
+    case SEEK_SET:
+        seq = offset;
+        break;
+    case SEEK_CUR:
+        seq = sfile->seq + offset;
+        break;
+    case SEEK_END:
+        seq = smp_load_acquire(&ring->hdr->write_seq) + offset;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    WRITE_ONCE(sfile->seq, seq);
+
+    return seq;
+}
+
+static __poll_t sensor_dev_poll(struct file *file, poll_table *wait)
+{
+    struct sensor_file *sfile = file->private_data;
+    struct sensor_ring *ring = &sfile->sensor->ring;
+
+    poll_wait(file, &ring->wq, wait);
+    if (!sensor_ring_empty(ring, sfile->seq))
+        return EPOLLIN | EPOLLRDNORM;
+
     return 0;
 }
  
 /* ioctl - I/O control */
+/**
+ * 设置校准参数，立即生效并保存到 vendor storage。
+ * 保存失败时校准仍然生效，返回错误让调用者知道下次开机需要重新校准。
+ */
+static long sensor_dev_set_calib(struct sensor_private_data *sensor, void __user *argp)
+{
+    struct sensor_calib calib;
+    int result;
+
+    if (copy_from_user(&calib, argp, sizeof(calib)))
+        return -EFAULT;
+    if (!sensor_calib_valid(&calib))
+        return -EINVAL;
+
+    mutex_lock(&sensor->operation_mutex);
+    /* 先读出保存的校准，避免之后第一次打开时被旧值覆盖 */
+    sensor_calib_load(sensor);
+    sensor->calib_loaded = 1;
+    sensor_calib_apply(sensor, &calib);
+    result = sensor_calib_save(sensor);
+    mutex_unlock(&sensor->operation_mutex);
+    if (result)
+        dev_warn(&sensor->client->dev, "%s: save calibration failed %d\n", __func__, result);
+
+    return result;
+}
+
+/**
+ * 设置零偏的温度补偿表，count 为 0 时取消补偿。与校准参数一起保存到 vendor storage。
+ */
+static long sensor_dev_set_tcomp(struct sensor_private_data *sensor, void __user *argp)
+{
+    struct sensor_tcomp *tcomp;
+    int result;
+
+    tcomp = memdup_user(argp, sizeof(*tcomp));
+    if (IS_ERR(tcomp))
+        return PTR_ERR(tcomp);
+    if (!sensor_tcomp_valid(tcomp)) {
+        kfree(tcomp);
+        return -EINVAL;
+    }
+
+    mutex_lock(&sensor->operation_mutex);
+    sensor_calib_load(sensor);
+    sensor->calib_loaded = 1;
+    sensor_tcomp_apply(sensor, tcomp);
+    result = sensor_calib_save(sensor);
+    mutex_unlock(&sensor->operation_mutex);
+    if (result)
+        dev_warn(&sensor->client->dev, "%s: save temperature compensation failed %d\n", __func__, result);
+
+    kfree(tcomp);
+
+    return result;
+}
+
+static long sensor_dev_get_tcomp(struct sensor_private_data *sensor, void __user *argp)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+    struct sensor_tcomp *tcomp;
+    long result = 0;
+
+    tcomp = kmalloc(sizeof(*tcomp), GFP_KERNEL);
+    if (!tcomp)
+        return -ENOMEM;
+
+    mutex_lock(&sensor->operation_mutex);
+    sensor_calib_load(sensor);
+    mutex_unlock(&sensor->operation_mutex);
+
+    mutex_lock(&master->sensor_mutex);
+    *tcomp = sensor->tcomp;
+    mutex_unlock(&master->sensor_mutex);
+
+    if (copy_to_user(argp, tcomp, sizeof(*tcomp)))
+        result = -EFAULT;
+    kfree(tcomp);
+
+    return result;
+}
+
+static long sensor_dev_get_calib(struct sensor_private_data *sensor, void __user *argp)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+    struct sensor_calib calib;
+
+    mutex_lock(&sensor->operation_mutex);
+    sensor_calib_load(sensor);
+    mutex_unlock(&sensor->operation_mutex);
+
+    mutex_lock(&master->sensor_mutex);
+    calib = sensor->calib;
+    mutex_unlock(&master->sensor_mutex);
+
+    if (copy_to_user(argp, &calib, sizeof(calib)))
+        return -EFAULT;
+
+    return 0;
+}
+
 static long gsensor_dev_ioctl(struct file *file,
             unsigned int cmd, unsigned long arg)
 {
-    struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_ACCEL];
+    struct sensor_private_data *sensor = sensor_from_file(file);
     struct i2c_client *client = sensor->client;
     void __user *argp = (void __user *)arg;
     struct sensor_axis axis = {0};
+    unsigned int period_us;
+    unsigned int events;
     short rate;
     int result = 0;
 
@@ -340,8 +1686,12 @@ static long gsensor_dev_ioctl(struct file *file,
         break;
 
     case SENSOR_ACCEL_IOCTL_SET_RATE:
+        if (copy_from_user(&rate, argp, sizeof(rate))) {
+            result = -EFAULT;
+            goto error;
+        }
         mutex_lock(&sensor->operation_mutex);
-        result = sensor_reset_rate(client, rate);
+        result = sensor_reset_rate(sensor, rate);
         if (result < 0) {
             mutex_unlock(&sensor->operation_mutex);
             goto error;
@@ -349,10 +1699,54 @@ static long gsensor_dev_ioctl(struct file *file,
         mutex_unlock(&sensor->operation_mutex);
         break;
 
+    case SENSOR_ACCEL_IOCTL_SET_PERIOD_US:
+        if (copy_from_user(&period_us, argp, sizeof(period_us))) {
+            result = -EFAULT;
+            goto error;
+        }
+        mutex_lock(&sensor->operation_mutex);
+        result = sensor_set_period(sensor, period_us);
+        mutex_unlock(&sensor->operation_mutex);
+        break;
+
+    case SENSOR_ACCEL_IOCTL_GET_POLL_MISSED:
+        result = put_user(atomic_read(&sensor_master(sensor)->poll_missed), (unsigned int __user *)argp);
+        break;
+
+    case SENSOR_ACCEL_IOCTL_GET_BATCH:
+        result = sensor_dev_get_batch(file, argp);
+        break;
+
+    case SENSOR_ACCEL_IOCTL_SET_CALIB:
+        result = sensor_dev_set_calib(sensor, argp);
+        break;
+
+    case SENSOR_ACCEL_IOCTL_GET_CALIB:
+        result = sensor_dev_get_calib(sensor, argp);
+        break;
+
+    case SENSOR_ACCEL_IOCTL_SET_TCOMP:
+        result = sensor_dev_set_tcomp(sensor, argp);
+        break;
+
+    case SENSOR_ACCEL_IOCTL_GET_TCOMP:
+        result = sensor_dev_get_tcomp(sensor, argp);
+        break;
+
+    case SENSOR_ACCEL_IOCTL_SET_EVENTS:
+        if (get_user(events, (unsigned int __user *)argp)) {
+            result = -EFAULT;
+            goto error;
+        }
+        result = sensor_dev_set_events(file->private_data, events);
+        break;
+
+    case SENSOR_ACCEL_IOCTL_GET_EVENTS:
+        result = put_user(sensor->events, (unsigned int __user *)argp);
+        break;
+
     case SENSOR_ACCEL_IOCTL_GETDATA:
-        mutex_lock(&sensor->data_mutex);
-        memcpy(&axis, &sensor->axis, sizeof(sensor->axis));
-        mutex_unlock(&sensor->data_mutex);
+        sensor_get_axis(sensor, &axis);
         if (copy_to_user(argp, &axis, sizeof(axis))) {
             dev_err(&client->dev, "failed to copy sense data to user space.\n");
             result = -EFAULT;
@@ -371,8 +1765,14 @@ error:
  
 static int compass_dev_open(struct inode *inode, struct file *file)
 {
-    struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_COMPASS];
+    struct sensor_private_data *sensor =
+        container_of(file->private_data, struct sensor_private_data, miscdev);
     int flag = 0;
+    int result;
+
+    result = sensor_dev_open(inode, file);
+    if (result)
+        return result;
 
     flag = atomic_read(&sensor->flags.open_flag);
     if (!flag) {
@@ -385,7 +1785,7 @@ static int compass_dev_open(struct inode *inode, struct file *file)
  
 static int compass_dev_release(struct inode *inode, struct file *file)
 {
-    struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_COMPASS];
+    struct sensor_private_data *sensor = sensor_from_file(file);
     int flag = 0;
 
     flag = atomic_read(&sensor->flags.open_flag);
@@ -394,7 +1794,7 @@ static int compass_dev_release(struct inode *inode, struct file *file)
         wake_up(&sensor->flags.open_wq);
     }
 
-    return 0;
+    return sensor_dev_release(inode, file);
 }
 
  
@@ -402,7 +1802,7 @@ static int compass_dev_release(struct inode *inode, struct file *file)
 static long compass_dev_ioctl(struct file *file,
             unsigned int cmd, unsigned long arg)
 {
-    struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_COMPASS];
+    struct sensor_private_data *sensor = sensor_from_file(file);
     struct i2c_client *client = sensor->client;
     void __user *argp = (void __user *)arg;
     int result = 0;
@@ -447,7 +1847,7 @@ static long compass_dev_ioctl(struct file *file,
     case ECS_IOCTL_APP_SET_DELAY:
         sensor->flags.delay = flag;
         mutex_lock(&sensor->operation_mutex);
-        result = sensor_reset_rate(client, flag);
+        result = sensor_reset_rate(sensor, flag);
         if (result < 0) {
             mutex_unlock(&sensor->operation_mutex);
             return result;
@@ -476,27 +1876,17 @@ static long compass_dev_ioctl(struct file *file,
     return result;
 }
  
-static int gyro_dev_open(struct inode *inode, struct file *file)
-{
-    return 0;
-}
-
-
-static int gyro_dev_release(struct inode *inode, struct file *file)
-{
-    return 0;
-}
- 
 /* ioctl - I/O control */
 static long gyro_dev_ioctl(struct file *file,
             unsigned int cmd, unsigned long arg)
 {
-    struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_GYROSCOPE];
+    struct sensor_private_data *sensor = sensor_from_file(file);
     struct i2c_client *client = sensor->client;
     void __user *argp = (void __user *)arg;
     struct sensor_axis axis = {0};
+    unsigned int period_us;
     int result = 0;
-    int rate;
+    short rate;
 
     wait_event_interruptible(sensor->is_factory_ok, (atomic_read(&sensor->is_factory) == 0));
 
@@ -522,8 +1912,12 @@ static long gyro_dev_ioctl(struct file *file,
             break;
     
         case SENSOR_GYRO_IOCTL_SET_RATE:
+            if (copy_from_user(&rate, argp, sizeof(rate))) {
+                result = -EFAULT;
+                goto error;
+            }
             mutex_lock(&sensor->operation_mutex);
-            result = sensor_reset_rate(client, rate);
+            result = sensor_reset_rate(sensor, rate);
             if (result < 0) {
                 mutex_unlock(&sensor->operation_mutex);
                 goto error;
@@ -531,10 +1925,42 @@ static long gyro_dev_ioctl(struct file *file,
             mutex_unlock(&sensor->operation_mutex);
             break;
     
+        case SENSOR_GYRO_IOCTL_SET_PERIOD_US:
+            if (copy_from_user(&period_us, argp, sizeof(period_us))) {
+                result = -EFAULT;
+                goto error;
+            }
+            mutex_lock(&sensor->operation_mutex);
+            result = sensor_set_period(sensor, period_us);
+            mutex_unlock(&sensor->operation_mutex);
+            break;
+
+        case SENSOR_GYRO_IOCTL_GET_POLL_MISSED:
+            result = put_user(atomic_read(&sensor_master(sensor)->poll_missed), (unsigned int __user *)argp);
+            break;
+
+        case SENSOR_GYRO_IOCTL_GET_BATCH:
+            result = sensor_dev_get_batch(file, argp);
+            break;
+
+        case SENSOR_GYRO_IOCTL_SET_CALIB:
+            result = sensor_dev_set_calib(sensor, argp);
+            break;
+
+        case SENSOR_GYRO_IOCTL_GET_CALIB:
+            result = sensor_dev_get_calib(sensor, argp);
+            break;
+
+        case SENSOR_GYRO_IOCTL_SET_TCOMP:
+            result = sensor_dev_set_tcomp(sensor, argp);
+            break;
+
+        case SENSOR_GYRO_IOCTL_GET_TCOMP:
+            result = sensor_dev_get_tcomp(sensor, argp);
+            break;
+
         case SENSOR_GYRO_IOCTL_GETDATA:
-            mutex_lock(&sensor->data_mutex);
-            memcpy(&axis, &sensor->axis, sizeof(sensor->axis));
-            mutex_unlock(&sensor->data_mutex);
+            sensor_get_axis(sensor, &axis);
             if (copy_to_user(argp, &axis, sizeof(axis))) {
                 dev_err(&client->dev, "failed to copy sense data to user space.\n");
                 result = -EFAULT;
@@ -551,21 +1977,84 @@ static long gyro_dev_ioctl(struct file *file,
         return result;
 }
  
- static int light_dev_open(struct inode *inode, struct file *file)
- {
-     return 0;
- }
- 
- static int light_dev_release(struct inode *inode, struct file *file)
- {
-     return 0;
- }
+/* ioctl - I/O control */
+static long angle_dev_ioctl(struct file *file,
+            unsigned int cmd, unsigned long arg)
+{
+    struct sensor_private_data *sensor = sensor_from_file(file);
+    struct i2c_client *client = sensor->client;
+    void __user *argp = (void __user *)arg;
+    struct sensor_axis axis = {0};
+    struct sensor_quat quat;
+    unsigned int period_us;
+    int result = 0;
+
+    switch (cmd) {
+        case SENSOR_ANGLE_IOCTL_START:
+            mutex_lock(&sensor->operation_mutex);
+            if (++sensor->start_count == 1) {
+                if (sensor->status_cur == SENSOR_OFF) {
+                    sensor_enable(sensor, SENSOR_ON);
+                }
+            }
+            mutex_unlock(&sensor->operation_mutex);
+            break;
+
+        case SENSOR_ANGLE_IOCTL_CLOSE:
+            mutex_lock(&sensor->operation_mutex);
+            if (--sensor->start_count == 0) {
+                if (sensor->status_cur == SENSOR_ON) {
+                    sensor_enable(sensor, SENSOR_OFF);
+                }
+            }
+            mutex_unlock(&sensor->operation_mutex);
+            break;
+
+        case SENSOR_ANGLE_IOCTL_SET_PERIOD_US:
+            if (copy_from_user(&period_us, argp, sizeof(period_us))) {
+                result = -EFAULT;
+                goto error;
+            }
+            mutex_lock(&sensor->operation_mutex);
+            result = sensor_set_period(sensor, period_us);
+            mutex_unlock(&sensor->operation_mutex);
+            break;
+
+        case SENSOR_ANGLE_IOCTL_GET_BATCH:
+            result = sensor_dev_get_batch(file, argp);
+            break;
+
+        case SENSOR_ANGLE_IOCTL_GETDATA:
+            sensor_get_axis(sensor, &axis);
+            if (copy_to_user(argp, &axis, sizeof(axis))) {
+                dev_err(&client->dev, "failed to copy sense data to user space.\n");
+                result = -EFAULT;
+                goto error;
+            }
+            break;
+
+        case SENSOR_ANGLE_IOCTL_GET_QUAT:
+            sensor_get_quat(sensor, &quat);
+            if (copy_to_user(argp, &quat, sizeof(quat))) {
+                result = -EFAULT;
+                goto error;
+            }
+            break;
+
+        default:
+            result = -ENOTTY;
+        goto error;
+        }
+
+    error:
+        return result;
+}
  
  /* ioctl - I/O control */
  static long light_dev_ioctl(struct file *file,
                unsigned int cmd, unsigned long arg)
  {
-     struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_LIGHT];
+     struct sensor_private_data *sensor = sensor_from_file(file);
      struct i2c_client *client = sensor->client;
      void __user *argp = (void __user *)arg;
      int result = 0;
@@ -578,7 +2067,7 @@ static long gyro_dev_ioctl(struct file *file,
              return -EFAULT;
          }
          mutex_lock(&sensor->operation_mutex);
-         result = sensor_reset_rate(client, rate);
+         result = sensor_reset_rate(sensor, rate);
          if (result < 0) {
              mutex_unlock(&sensor->operation_mutex);
              goto error;
@@ -617,21 +2106,11 @@ static long gyro_dev_ioctl(struct file *file,
      return result;
  }
  
- static int proximity_dev_open(struct inode *inode, struct file *file)
- {
-     return 0;
- }
- 
- static int proximity_dev_release(struct inode *inode, struct file *file)
- {
-     return 0;
- }
- 
  /* ioctl - I/O control */
  static long proximity_dev_ioctl(struct file *file,
                unsigned int cmd, unsigned long arg)
  {
-     struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_PROXIMITY];
+     struct sensor_private_data *sensor = sensor_from_file(file);
      void __user *argp = (void __user *)arg;
      int result = 0;
  
@@ -666,21 +2145,11 @@ static long gyro_dev_ioctl(struct file *file,
      return result;
  }
  
- static int temperature_dev_open(struct inode *inode, struct file *file)
- {
-     return 0;
- }
- 
- static int temperature_dev_release(struct inode *inode, struct file *file)
- {
-     return 0;
- }
- 
  /* ioctl - I/O control */
  static long temperature_dev_ioctl(struct file *file,
                unsigned int cmd, unsigned long arg)
  {
-     struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_TEMPERATURE];
+     struct sensor_private_data *sensor = sensor_from_file(file);
      void __user *argp = (void __user *)arg;
      int result = 0;
  
@@ -708,23 +2177,11 @@ static long gyro_dev_ioctl(struct file *file,
          mutex_unlock(&sensor->operation_mutex);
          break;
  
-     default:
-         break;
-     }
- 
-     return result;
- }
- 
- 
- static int pressure_dev_open(struct inode *inode, struct file *file)
- {
-     return 0;
- }
- 
+     default:
+         break;
+     }
  
- static int pressure_dev_release(struct inode *inode, struct file *file)
- {
-     return 0;
+     return result;
  }
  
  
@@ -732,7 +2189,7 @@ static long gyro_dev_ioctl(struct file *file,
  static long pressure_dev_ioctl(struct file *file,
                unsigned int cmd, unsigned long arg)
  {
-     struct sensor_private_data *sensor = g_sensor[SENSOR_TYPE_PRESSURE];
+     struct sensor_private_data *sensor = sensor_from_file(file);
      void __user *argp = (void __user *)arg;
      int result = 0;
  
@@ -767,6 +2224,179 @@ static long gyro_dev_ioctl(struct file *file,
      return result;
  }
  
+/*
+ * 性能计数：debugfs 下 jason_sensor/<设备名>/stats 一次给出全部计数，
+ * jason_sensor_class 下每个设备一个目录，每项计数一个属性文件，供采集程序读取。
+ * 直方图为 SENSOR_HIST_BUCKETS 个以空格分隔的计数。
+ */
+
+/* 对所有 CPU 求和，i2c 传输由主设备完成，从设备显示主设备的 i2c 计数 */
+static void sensor_stats_read(struct sensor_private_data *sensor, struct sensor_stats *sum)
+{
+    struct sensor_private_data *master = sensor_master(sensor);
+    const struct sensor_stats *stats, *mstats;
+    int cpu, i;
+
+    memset(sum, 0, sizeof(*sum));
+    for_each_possible_cpu(cpu) {
+        stats = per_cpu_ptr(sensor->stats, cpu);
+        mstats = per_cpu_ptr(master->stats, cpu);
+        sum->samples += stats->samples;
+        sum->i2c_xfers += mstats->i2c_xfers;
+        sum->i2c_errors += mstats->i2c_errors;
+        for (i = 0; i < SENSOR_HIST_BUCKETS; i++) {
+            sum->i2c_hist[i] += mstats->i2c_hist[i];
+            sum->latency_hist[i] += stats->latency_hist[i];
+        }
+    }
+}
+
+/* 错过的轮询周期记在主设备上，中断模式下为 0 */
+static int sensor_stats_poll_missed(struct sensor_private_data *sensor)
+{
+    return atomic_read(&sensor_master(sensor)->poll_missed);
+}
+
+static void sensor_stats_seq_hist(struct seq_file *m, const char *name, const u64 *hist)
+{
+    int i;
+
+    seq_printf(m, "%s:", name);
+    for (i = 0; i < SENSOR_HIST_BUCKETS; i++)
+        seq_printf(m, " %llu", hist[i]);
+    seq_putc(m, '\n');
+}
+
+static int sensor_stats_show(struct seq_file *m, void *v)
+{
+    struct sensor_private_data *sensor = m->private;
+    struct sensor_stats sum;
+
+    sensor_stats_read(sensor, &sum);
+    seq_printf(m, "samples: %llu\n", sum.samples);
+    seq_printf(m, "i2c_xfers: %llu\n", sum.i2c_xfers);
+    seq_printf(m, "i2c_errors: %llu\n", sum.i2c_errors);
+    seq_printf(m, "poll_missed: %d\n", sensor_stats_poll_missed(sensor));
+    seq_printf(m, "ring_overruns: %u\n", READ_ONCE(sensor->ring.hdr->overruns));
+    seq_printf(m, "readers: %d\n", atomic_read(&sensor->readers));
+    sensor_stats_seq_hist(m, "i2c_ns_log2", sum.i2c_hist);
+    sensor_stats_seq_hist(m, "latency_ns_log2", sum.latency_hist);
+
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sensor_stats);
+
+#define SENSOR_STATS_ATTR(field)						\
+static ssize_t field##_show(struct device *dev,				\
+            struct device_attribute *attr, char *buf)			\
+{										\
+    struct sensor_stats sum;							\
+										\
+    sensor_stats_read(dev_get_drvdata(dev), &sum);				\
+    return sprintf(buf, "%llu\n", sum.field);				\
+}										\
+static DEVICE_ATTR_RO(field)
+
+SENSOR_STATS_ATTR(samples);
+SENSOR_STATS_ATTR(i2c_xfers);
+SENSOR_STATS_ATTR(i2c_errors);
+
+static ssize_t poll_missed_show(struct device *dev,
+            struct device_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%d\n", sensor_stats_poll_missed(dev_get_drvdata(dev)));
+}
+static DEVICE_ATTR_RO(poll_missed);
+
+static ssize_t ring_overruns_show(struct device *dev,
+            struct device_attribute *attr, char *buf)
+{
+    struct sensor_private_data *sensor = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%u\n", READ_ONCE(sensor->ring.hdr->overruns));
+}
+static DEVICE_ATTR_RO(ring_overruns);
+
+static ssize_t readers_show(struct device *dev,
+            struct device_attribute *attr, char *buf)
+{
+    struct sensor_private_data *sensor = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%d\n", atomic_read(&sensor->readers));
+}
+static DEVICE_ATTR_RO(readers);
+
+static ssize_t sensor_stats_hist_show(char *buf, const u64 *hist)
+{
+    ssize_t len = 0;
+    int i;
+
+    for (i = 0; i < SENSOR_HIST_BUCKETS; i++)
+        len += scnprintf(buf + len, PAGE_SIZE - len, "%llu%c", hist[i],
+            i == SENSOR_HIST_BUCKETS - 1 ? '\n' : ' ');
+
+    return len;
+}
+
+static ssize_t i2c_ns_log2_show(struct device *dev,
+            struct device_attribute *attr, char *buf)
+{
+    struct sensor_stats sum;
+
+    sensor_stats_read(dev_get_drvdata(dev), &sum);
+    return sensor_stats_hist_show(buf, sum.i2c_hist);
+}
+static DEVICE_ATTR_RO(i2c_ns_log2);
+
+static ssize_t latency_ns_log2_show(struct device *dev,
+            struct device_attribute *attr, char *buf)
+{
+    struct sensor_stats sum;
+
+    sensor_stats_read(dev_get_drvdata(dev), &sum);
+    return sensor_stats_hist_show(buf, sum.latency_hist);
+}
+static DEVICE_ATTR_RO(latency_ns_log2);
+
+static struct attribute *sensor_stats_attrs[] = {
+    &dev_attr_samples.attr,
+    &dev_attr_i2c_xfers.attr,
+    &dev_attr_i2c_errors.attr,
+    &dev_attr_poll_missed.attr,
+    &dev_attr_ring_overruns.attr,
+    &dev_attr_readers.attr,
+    &dev_attr_i2c_ns_log2.attr,
+    &dev_attr_latency_ns_log2.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(sensor_stats);
+
+/* 导出性能计数失败不影响传感器工作，只打印警告 */
+static void sensor_stats_register(struct sensor_private_data *sensor)
+{
+    struct device *dev = &sensor->client->dev;
+
+    sensor->debugfs = debugfs_create_dir(sensor->miscdev.name, sensor_debugfs_root);
+    debugfs_create_file("stats", 0444, sensor->debugfs, sensor, &sensor_stats_fops);
+
+    sensor->class_dev = device_create(jason_sensor_class, dev, MKDEV(0, 0), sensor,
+        "%s", sensor->miscdev.name);
+    if (IS_ERR(sensor->class_dev)) {
+        dev_warn(dev, "%s:fail to create class device %s, ret=%ld\n", __func__,
+            sensor->miscdev.name, PTR_ERR(sensor->class_dev));
+        sensor->class_dev = NULL;
+    }
+}
+
+static void sensor_stats_unregister(struct sensor_private_data *sensor)
+{
+    if (sensor->class_dev)
+        device_unregister(sensor->class_dev);
+    sensor->class_dev = NULL;
+    debugfs_remove_recursive(sensor->debugfs);
+    sensor->debugfs = NULL;
+}
+
 static int sensor_misc_device_register(struct sensor_private_data *sensor, int type)
 {
     int result = 0;
@@ -776,8 +2406,12 @@ static int sensor_misc_device_register(struct sensor_private_data *sensor, int t
         if (!sensor->ops->misc_dev) {
             sensor->fops.owner = THIS_MODULE;
             sensor->fops.unlocked_ioctl = gsensor_dev_ioctl;
-            sensor->fops.open = gsensor_dev_open;
-            sensor->fops.release = gsensor_dev_release;
+            sensor->fops.open = sensor_dev_open;
+            sensor->fops.release = sensor_dev_release;
+            sensor->fops.read = sensor_dev_read;
+            sensor->fops.poll = sensor_dev_poll;
+            sensor->fops.mmap = sensor_dev_mmap;
+            sensor->fops.llseek = sensor_dev_llseek;
 
             sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
             sensor->miscdev.name = "sensor_accel";
@@ -806,8 +2440,12 @@ static int sensor_misc_device_register(struct sensor_private_data *sensor, int t
         if (!sensor->ops->misc_dev) {
             sensor->fops.owner = THIS_MODULE;
             sensor->fops.unlocked_ioctl = gyro_dev_ioctl;
-            sensor->fops.open = gyro_dev_open;
-            sensor->fops.release = gyro_dev_release;
+            sensor->fops.open = sensor_dev_open;
+            sensor->fops.release = sensor_dev_release;
+            sensor->fops.read = sensor_dev_read;
+            sensor->fops.poll = sensor_dev_poll;
+            sensor->fops.mmap = sensor_dev_mmap;
+            sensor->fops.llseek = sensor_dev_llseek;
 
             sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
             sensor->miscdev.name = "sensor_gyro";
@@ -816,87 +2454,313 @@ static int sensor_misc_device_register(struct sensor_private_data *sensor, int t
             memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
         }
         break;
-
+
+    case SENSOR_TYPE_ANGLE:
+        if (!sensor->ops->misc_dev) {
+            sensor->fops.owner = THIS_MODULE;
+            sensor->fops.unlocked_ioctl = angle_dev_ioctl;
+            sensor->fops.open = sensor_dev_open;
+            sensor->fops.release = sensor_dev_release;
+            sensor->fops.read = sensor_dev_read;
+            sensor->fops.poll = sensor_dev_poll;
+            sensor->fops.mmap = sensor_dev_mmap;
+            sensor->fops.llseek = sensor_dev_llseek;
+
+            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
+            sensor->miscdev.name = "sensor_angle";
+            sensor->miscdev.fops = &sensor->fops;
+        } else {
+            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
+        }
+        break;
+
+    case SENSOR_TYPE_LIGHT:
+        if (!sensor->ops->misc_dev) {
+            sensor->fops.owner = THIS_MODULE;
+            sensor->fops.unlocked_ioctl = light_dev_ioctl;
+            sensor->fops.open = sensor_dev_open;
+            sensor->fops.release = sensor_dev_release;
+
+            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
+            sensor->miscdev.name = "lightsensor";
+            sensor->miscdev.fops = &sensor->fops;
+        } else {
+            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
+        }
+        break;
+
+    case SENSOR_TYPE_PROXIMITY:
+        if (!sensor->ops->misc_dev) {
+            sensor->fops.owner = THIS_MODULE;
+            sensor->fops.unlocked_ioctl = proximity_dev_ioctl;
+            sensor->fops.open = sensor_dev_open;
+            sensor->fops.release = sensor_dev_release;
+
+            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
+            sensor->miscdev.name = "psensor";
+            sensor->miscdev.fops = &sensor->fops;
+        } else {
+            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
+        }
+        break;
+
+    case SENSOR_TYPE_TEMPERATURE:
+        if (!sensor->ops->misc_dev) {
+            sensor->fops.owner = THIS_MODULE;
+            sensor->fops.unlocked_ioctl = temperature_dev_ioctl;
+            sensor->fops.open = sensor_dev_open;
+            sensor->fops.release = sensor_dev_release;
+            sensor->fops.read = sensor_dev_read;
+            sensor->fops.poll = sensor_dev_poll;
+            sensor->fops.mmap = sensor_dev_mmap;
+            sensor->fops.llseek = sensor_dev_llseek;
+
+            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
+            sensor->miscdev.name = "temperature";
+            sensor->miscdev.fops = &sensor->fops;
+        } else {
+            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
+        }
+        break;
+
+    case SENSOR_TYPE_PRESSURE:
+        if (!sensor->ops->misc_dev) {
+            sensor->fops.owner = THIS_MODULE;
+            sensor->fops.unlocked_ioctl = pressure_dev_ioctl;
+            sensor->fops.open = sensor_dev_open;
+            sensor->fops.release = sensor_dev_release;
+
+            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
+            sensor->miscdev.name = "pressure";
+            sensor->miscdev.fops = &sensor->fops;
+        } else {
+            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
+        }
+        break;
+
+    default:
+        dev_err(&sensor->client->dev, "%s:unknow sensor type=%d\n", __func__, type);
+        result = -1;
+        goto error;
+    }
+
+    /* 同类型的第一个实例保留原来的名字，其余实例在名字后加编号，例如 sensor_accel1 */
+    result = ida_simple_get(&sensor_ida[type], 0, 0, GFP_KERNEL);
+    if (result < 0)
+        goto error;
+    sensor->index = result;
+    if (sensor->index > 0) {
+        snprintf(sensor->misc_name, sizeof(sensor->misc_name), "%s%d",
+            sensor->miscdev.name, sensor->index);
+        sensor->miscdev.name = sensor->misc_name;
+    }
+
+    sensor->miscdev.parent = &sensor->client->dev;
+    result = misc_register(&sensor->miscdev);
+    if (result < 0) {
+        dev_err(&sensor->client->dev,
+            "fail to register misc device %s\n", sensor->miscdev.name);
+        ida_simple_remove(&sensor_ida[type], sensor->index);
+        goto error;
+    }
+    dev_info(&sensor->client->dev, "%s:miscdevice: %s\n", __func__, sensor->miscdev.name);
+    sensor_stats_register(sensor);
+
+error:
+    return result;
+}
+
+static void sensor_misc_device_unregister(struct sensor_private_data *sensor)
+{
+    sensor_stats_unregister(sensor);
+    misc_deregister(&sensor->miscdev);
+    ida_simple_remove(&sensor_ida[sensor->type], sensor->index);
+}
+ 
+/**
+ * 初始化 sensor_private_data 中与具体器件无关的部分：数据环形缓冲区、互斥锁、标志位。
+ */
+static int sensor_data_init(struct sensor_private_data *sensor)
+{
+    struct i2c_client *client = sensor->client;
+    int result;
+    int i;
+
+    memset(&(sensor->axis), 0, sizeof(struct sensor_axis));
+    result = sensor_ring_init(&sensor->ring, SENSOR_RING_SIZE);
+    if (result)
+        return result;
+    result = devm_add_action_or_reset(&client->dev, sensor_ring_free, &sensor->ring);
+    if (result)
+        return result;
+    sensor->stats = devm_alloc_percpu(&client->dev, struct sensor_stats);
+    if (!sensor->stats)
+        return -ENOMEM;
+    atomic_set(&sensor->readers, 0);
+    seqlock_init(&sensor->axis_lock);
+    INIT_LIST_HEAD(&sensor->companions);
+    INIT_LIST_HEAD(&sensor->companion_node);
+    mutex_init(&sensor->operation_mutex);
+    mutex_init(&sensor->sensor_mutex);
+    mutex_init(&sensor->i2c_mutex);
+
+    atomic_set(&sensor->is_factory, 0);
+    init_waitqueue_head(&sensor->is_factory_ok);
+
+    /* As default, report all information */
+    atomic_set(&sensor->flags.m_flag, 1);
+    atomic_set(&sensor->flags.a_flag, 1);
+    atomic_set(&sensor->flags.mv_flag, 1);
+    atomic_set(&sensor->flags.open_flag, 0);
+    atomic_set(&sensor->flags.debug_flag, 1);
+    init_waitqueue_head(&sensor->flags.open_wq);
+    sensor->flags.delay = 100;
+
+    sensor->status_cur = SENSOR_OFF;
+    sensor->axis.x = 0;
+    sensor->axis.y = 0;
+    sensor->axis.z = 0;
+
+    /* 未校准：零偏为 0，增益为 1，没有温度补偿 */
+    for (i = 0; i < 3; i++) {
+        sensor->calib.bias[i] = 0;
+        sensor->calib.scale[i] = SENSOR_CALIB_ONE;
+        sensor->tbias[i] = 0;
+    }
+    sensor->tcomp.count = 0;
+    sensor->temp_mdeg = 25000;
+    sensor_update_xform(sensor);
+
+    return 0;
+}
+
+/**
+ * 分配、设置并注册传感器对应的输入设备。
+ */
+static int sensor_input_init(struct sensor_private_data *sensor)
+{
+    struct i2c_client *client = sensor->client;
+    int result = 0;
+
+    // 分配并初始化输入设备
+    sensor->input_dev = devm_input_allocate_device(&client->dev);
+    if (!sensor->input_dev) {
+        result = -ENOMEM;
+        dev_err(&client->dev,
+            "Failed to allocate input device\n");
+        return result;
+    }
+
+    /* 根据器件类型，设置要上报的数据 */
+    switch (sensor->type) {
+    case SENSOR_TYPE_ANGLE:
+        sensor->input_dev->name = "angle";
+        set_bit(EV_ABS, sensor->input_dev->evbit);
+        /* x-axis acceleration */
+        input_set_abs_params(sensor->input_dev, ABS_X, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        /* y-axis acceleration */
+        input_set_abs_params(sensor->input_dev, ABS_Y, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        /* z-axis acceleration */
+        input_set_abs_params(sensor->input_dev, ABS_Z, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        break;
+    case SENSOR_TYPE_ACCEL:
+        sensor->input_dev->name = "gsensor";
+        set_bit(EV_ABS, sensor->input_dev->evbit);
+        /* x-axis acceleration */
+        input_set_abs_params(sensor->input_dev, ABS_X, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        /* y-axis acceleration */
+        input_set_abs_params(sensor->input_dev, ABS_Y, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        /* z-axis acceleration */
+        input_set_abs_params(sensor->input_dev, ABS_Z, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        break;
+    case SENSOR_TYPE_COMPASS:
+        sensor->input_dev->name = "compass";
+        /* Setup input device */
+        set_bit(EV_ABS, sensor->input_dev->evbit);
+        /* yaw (0, 360) */
+        input_set_abs_params(sensor->input_dev, ABS_RX, 0, 23040, 0, 0);
+        /* pitch (-180, 180) */
+        input_set_abs_params(sensor->input_dev, ABS_RY, -11520, 11520, 0, 0);
+        /* roll (-90, 90) */
+        input_set_abs_params(sensor->input_dev, ABS_RZ, -5760, 5760, 0, 0);
+        /* x-axis acceleration (720 x 8G) */
+        input_set_abs_params(sensor->input_dev, ABS_X, -5760, 5760, 0, 0);
+        /* y-axis acceleration (720 x 8G) */
+        input_set_abs_params(sensor->input_dev, ABS_Y, -5760, 5760, 0, 0);
+        /* z-axis acceleration (720 x 8G) */
+        input_set_abs_params(sensor->input_dev, ABS_Z, -5760, 5760, 0, 0);
+        /* status of magnetic sensor */
+        input_set_abs_params(sensor->input_dev, ABS_RUDDER, -32768, 3, 0, 0);
+        /* status of acceleration sensor */
+        input_set_abs_params(sensor->input_dev, ABS_WHEEL, -32768, 3, 0, 0);
+        /* x-axis of raw magnetic vector (-4096, 4095) */
+        input_set_abs_params(sensor->input_dev, ABS_HAT0X, -20480, 20479, 0, 0);
+        /* y-axis of raw magnetic vector (-4096, 4095) */
+        input_set_abs_params(sensor->input_dev, ABS_HAT0Y, -20480, 20479, 0, 0);
+        /* z-axis of raw magnetic vector (-4096, 4095) */
+        input_set_abs_params(sensor->input_dev, ABS_BRAKE, -20480, 20479, 0, 0);
+        break;
+    case SENSOR_TYPE_GYROSCOPE:
+        sensor->input_dev->name = "gyro";
+        /* x-axis acceleration */
+        // 相对运动事件，相对旋转或移动
+        input_set_capability(sensor->input_dev, EV_REL, REL_RX);
+        input_set_abs_params(sensor->input_dev, ABS_RX, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        /* y-axis acceleration */
+        input_set_capability(sensor->input_dev, EV_REL, REL_RY);
+        input_set_abs_params(sensor->input_dev, ABS_RY, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        /* z-axis acceleration */
+        input_set_capability(sensor->input_dev, EV_REL, REL_RZ);
+        input_set_abs_params(sensor->input_dev, ABS_RZ, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        break;
     case SENSOR_TYPE_LIGHT:
-        if (!sensor->ops->misc_dev) {
-            sensor->fops.owner = THIS_MODULE;
-            sensor->fops.unlocked_ioctl = light_dev_ioctl;
-            sensor->fops.open = light_dev_open;
-            sensor->fops.release = light_dev_release;
-
-            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
-            sensor->miscdev.name = "lightsensor";
-            sensor->miscdev.fops = &sensor->fops;
-        } else {
-            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
-        }
+        sensor->input_dev->name = "lightsensor-level";
+        set_bit(EV_ABS, sensor->input_dev->evbit);
+        input_set_abs_params(sensor->input_dev, ABS_MISC, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
+        input_set_abs_params(sensor->input_dev, ABS_TOOL_WIDTH,  sensor->ops->brightness[0], sensor->ops->brightness[1], 0, 0);
         break;
-
     case SENSOR_TYPE_PROXIMITY:
-        if (!sensor->ops->misc_dev) {
-            sensor->fops.owner = THIS_MODULE;
-            sensor->fops.unlocked_ioctl = proximity_dev_ioctl;
-            sensor->fops.open = proximity_dev_open;
-            sensor->fops.release = proximity_dev_release;
-
-            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
-            sensor->miscdev.name = "psensor";
-            sensor->miscdev.fops = &sensor->fops;
-        } else {
-            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
-        }
+        sensor->input_dev->name = "proximity";
+        set_bit(EV_ABS, sensor->input_dev->evbit);
+        input_set_abs_params(sensor->input_dev, ABS_DISTANCE, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
         break;
-
     case SENSOR_TYPE_TEMPERATURE:
-        if (!sensor->ops->misc_dev) {
-            sensor->fops.owner = THIS_MODULE;
-            sensor->fops.unlocked_ioctl = temperature_dev_ioctl;
-            sensor->fops.open = temperature_dev_open;
-            sensor->fops.release = temperature_dev_release;
-
-            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
-            sensor->miscdev.name = "temperature";
-            sensor->miscdev.fops = &sensor->fops;
-        } else {
-            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
-        }
+        sensor->input_dev->name = "temperature";
+        set_bit(EV_ABS, sensor->input_dev->evbit);
+        input_set_abs_params(sensor->input_dev, ABS_THROTTLE, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
         break;
-
     case SENSOR_TYPE_PRESSURE:
-        if (!sensor->ops->misc_dev) {
-            sensor->fops.owner = THIS_MODULE;
-            sensor->fops.unlocked_ioctl = pressure_dev_ioctl;
-            sensor->fops.open = pressure_dev_open;
-            sensor->fops.release = pressure_dev_release;
-
-            sensor->miscdev.minor = MISC_DYNAMIC_MINOR;
-            sensor->miscdev.name = "pressure";
-            sensor->miscdev.fops = &sensor->fops;
-        } else {
-            memcpy(&sensor->miscdev, sensor->ops->misc_dev, sizeof(*sensor->ops->misc_dev));
-        }
+        sensor->input_dev->name = "pressure";
+        set_bit(EV_ABS, sensor->input_dev->evbit);
+        input_set_abs_params(sensor->input_dev, ABS_PRESSURE, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
         break;
-
     default:
-        dev_err(&sensor->client->dev, "%s:unknow sensor type=%d\n", __func__, type);
-        result = -1;
-        goto error;
+        dev_err(&client->dev, "%s:unknow sensor type=%d\n", __func__, sensor->type);
+        break;
     }
+    sensor->input_dev->dev.parent = &client->dev;
+    sensor_update_abs_range(sensor);
 
-    sensor->miscdev.parent = &sensor->client->dev;
-    result = misc_register(&sensor->miscdev);
-    if (result < 0) {
-        dev_err(&sensor->client->dev,
-            "fail to register misc device %s\n", sensor->miscdev.name);
-        goto error;
+    /* 每个样本附带采集时刻（MSC_TIMESTAMP），FIFO 模式下一次上报多个样本，按水位放大缓冲区 */
+    input_set_capability(sensor->input_dev, EV_MSC, MSC_TIMESTAMP);
+    if (sensor->ops->events)
+        input_set_capability(sensor->input_dev, EV_MSC, MSC_GESTURE);
+    input_set_events_per_packet(sensor->input_dev,
+        SENSOR_EVENTS_PER_SAMPLE * max(sensor->pdata->fifo_watermark, 1));
+
+    // 注册输入设备
+    result = input_register_device(sensor->input_dev);
+    if (result) {
+        dev_err(&client->dev,
+            "Unable to register input device %s\n", sensor->input_dev->name);
+        return result;
     }
-    dev_info(&sensor->client->dev, "%s:miscdevice: %s\n", __func__, sensor->miscdev.name);
 
-error:
-    return result;
+    return 0;
 }
- 
-static int sensor_probe(struct i2c_client *client, const struct i2c_device_id *devid)
+
+static int sensor_probe(struct i2c_client *client, const struct i2c_device_id *devid,
+            struct sensor_operate *ops)
 {
     struct sensor_private_data *sensor;
     struct sensor_platform_data *pdata;
@@ -938,6 +2802,15 @@ static int sensor_probe(struct i2c_client *client, const struct i2c_device_id *d
     pdata->wake_enable = of_property_read_bool(np, "wakeup-source");
     of_property_read_u32(np, "irq_enable", &(pdata->irq_enable));
     of_property_read_u32(np, "poll_delay_ms", &(pdata->poll_delay_ms));
+    of_property_read_u32(np, "poll_period_us", &(pdata->poll_period_us));
+    of_property_read_u32(np, "rt_priority", &(pdata->rt_priority));
+    pdata->cpu_affinity = -1;
+    of_property_read_u32(np, "cpu_affinity", &(pdata->cpu_affinity));
+    of_property_read_u32(np, "odr_hz", &(pdata->odr_hz));
+    of_property_read_u32(np, "fifo_watermark", &(pdata->fifo_watermark));
+    of_property_read_u32(np, "si_units", &(pdata->si_units));
+    pdata->autosuspend_delay_ms = SENSOR_AUTOSUSPEND_DELAY_MS;
+    of_property_read_u32(np, "autosuspend_delay_ms", &(pdata->autosuspend_delay_ms));
 
     of_property_read_u32(np, "x_min", &(pdata->x_min));
     of_property_read_u32(np, "y_min", &(pdata->y_min));
@@ -1100,144 +2973,26 @@ static int sensor_probe(struct i2c_client *client, const struct i2c_device_id *d
     sensor->type = type;
     sensor->i2c_id = (struct i2c_device_id *)devid;
 
-    memset(&(sensor->axis), 0, sizeof(struct sensor_axis));
-    mutex_init(&sensor->data_mutex);
-    mutex_init(&sensor->operation_mutex);
-    mutex_init(&sensor->sensor_mutex);
-    mutex_init(&sensor->i2c_mutex);
-
-    atomic_set(&sensor->is_factory, 0);
-    init_waitqueue_head(&sensor->is_factory_ok);
-
-    /* As default, report all information */
-    atomic_set(&sensor->flags.m_flag, 1);
-    atomic_set(&sensor->flags.a_flag, 1);
-    atomic_set(&sensor->flags.mv_flag, 1);
-    atomic_set(&sensor->flags.open_flag, 0);
-    atomic_set(&sensor->flags.debug_flag, 1);
-    init_waitqueue_head(&sensor->flags.open_wq);
-    sensor->flags.delay = 100;
-
-    sensor->status_cur = SENSOR_OFF;
-    sensor->axis.x = 0;
-    sensor->axis.y = 0;
-    sensor->axis.z = 0;
+    result = sensor_data_init(sensor);
+    if (result)
+        goto out_no_free;
 
-    result = sensor_chip_init(sensor->client);
-    if (result < 0) {
-        if (reprobe_en && (result == -2)) {
-            sensor_probe_times[sensor->ops->id_i2c]++;
-            if (sensor_probe_times[sensor->ops->id_i2c] < 3)
-                result = -EPROBE_DEFER;
-        }
-        goto out_free_memory;
+    /*
+     * sensor 是 devm 分配的，probe 失败后会被释放，重试次数无法跨过 -EPROBE_DEFER 保存，
+     * 因此芯片暂时无响应时在本次 probe 中等待后重试
+     */
+    result = sensor_chip_init(sensor->client, ops);
+    while ((result == -2) && reprobe_en && (++sensor->probe_times < SENSOR_PROBE_RETRY)) {
+        dev_warn(&client->dev, "%s:%s not ready, retry %d\n", __func__, ops->name, sensor->probe_times);
+        msleep(SENSOR_PROBE_RETRY_DELAY_MS);
+        result = sensor_chip_init(sensor->client, ops);
     }
-
-    // 分配并初始化输入设备
-    sensor->input_dev = devm_input_allocate_device(&client->dev);
-    if (!sensor->input_dev) {
-        result = -ENOMEM;
-        dev_err(&client->dev,
-            "Failed to allocate input device\n");
+    if (result < 0)
         goto out_free_memory;
-    }
-
-    /* 根据器件类型，设置要上报的数据 */
-    switch (type) {
-    case SENSOR_TYPE_ANGLE:
-        sensor->input_dev->name = "angle";
-        set_bit(EV_ABS, sensor->input_dev->evbit);
-        /* x-axis acceleration */
-        input_set_abs_params(sensor->input_dev, ABS_X, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        /* y-axis acceleration */
-        input_set_abs_params(sensor->input_dev, ABS_Y, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        /* z-axis acceleration */
-        input_set_abs_params(sensor->input_dev, ABS_Z, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        break;
-    case SENSOR_TYPE_ACCEL:
-        sensor->input_dev->name = "gsensor";
-        set_bit(EV_ABS, sensor->input_dev->evbit);
-        /* x-axis acceleration */
-        input_set_abs_params(sensor->input_dev, ABS_X, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        /* y-axis acceleration */
-        input_set_abs_params(sensor->input_dev, ABS_Y, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        /* z-axis acceleration */
-        input_set_abs_params(sensor->input_dev, ABS_Z, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        break;
-    case SENSOR_TYPE_COMPASS:
-        sensor->input_dev->name = "compass";
-        /* Setup input device */
-        set_bit(EV_ABS, sensor->input_dev->evbit);
-        /* yaw (0, 360) */
-        input_set_abs_params(sensor->input_dev, ABS_RX, 0, 23040, 0, 0);
-        /* pitch (-180, 180) */
-        input_set_abs_params(sensor->input_dev, ABS_RY, -11520, 11520, 0, 0);
-        /* roll (-90, 90) */
-        input_set_abs_params(sensor->input_dev, ABS_RZ, -5760, 5760, 0, 0);
-        /* x-axis acceleration (720 x 8G) */
-        input_set_abs_params(sensor->input_dev, ABS_X, -5760, 5760, 0, 0);
-        /* y-axis acceleration (720 x 8G) */
-        input_set_abs_params(sensor->input_dev, ABS_Y, -5760, 5760, 0, 0);
-        /* z-axis acceleration (720 x 8G) */
-        input_set_abs_params(sensor->input_dev, ABS_Z, -5760, 5760, 0, 0);
-        /* status of magnetic sensor */
-        input_set_abs_params(sensor->input_dev, ABS_RUDDER, -32768, 3, 0, 0);
-        /* status of acceleration sensor */
-        input_set_abs_params(sensor->input_dev, ABS_WHEEL, -32768, 3, 0, 0);
-        /* x-axis of raw magnetic vector (-4096, 4095) */
-        input_set_abs_params(sensor->input_dev, ABS_HAT0X, -20480, 20479, 0, 0);
-        /* y-axis of raw magnetic vector (-4096, 4095) */
-        input_set_abs_params(sensor->input_dev, ABS_HAT0Y, -20480, 20479, 0, 0);
-        /* z-axis of raw magnetic vector (-4096, 4095) */
-        input_set_abs_params(sensor->input_dev, ABS_BRAKE, -20480, 20479, 0, 0);
-        break;
-    case SENSOR_TYPE_GYROSCOPE:
-        sensor->input_dev->name = "gyro";
-        /* x-axis acceleration */
-        // 相对运动事件，相对旋转或移动
-        input_set_capability(sensor->input_dev, EV_REL, REL_RX);
-        input_set_abs_params(sensor->input_dev, ABS_RX, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        /* y-axis acceleration */
-        input_set_capability(sensor->input_dev, EV_REL, REL_RY);
-        input_set_abs_params(sensor->input_dev, ABS_RY, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        /* z-axis acceleration */
-        input_set_capability(sensor->input_dev, EV_REL, REL_RZ);
-        input_set_abs_params(sensor->input_dev, ABS_RZ, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        break;
-    case SENSOR_TYPE_LIGHT:
-        sensor->input_dev->name = "lightsensor-level";
-        set_bit(EV_ABS, sensor->input_dev->evbit);
-        input_set_abs_params(sensor->input_dev, ABS_MISC, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        input_set_abs_params(sensor->input_dev, ABS_TOOL_WIDTH,  sensor->ops->brightness[0], sensor->ops->brightness[1], 0, 0);
-        break;
-    case SENSOR_TYPE_PROXIMITY:
-        sensor->input_dev->name = "proximity";
-        set_bit(EV_ABS, sensor->input_dev->evbit);
-        input_set_abs_params(sensor->input_dev, ABS_DISTANCE, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        break;
-    case SENSOR_TYPE_TEMPERATURE:
-        sensor->input_dev->name = "temperature";
-        set_bit(EV_ABS, sensor->input_dev->evbit);
-        input_set_abs_params(sensor->input_dev, ABS_THROTTLE, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        break;
-    case SENSOR_TYPE_PRESSURE:
-        sensor->input_dev->name = "pressure";
-        set_bit(EV_ABS, sensor->input_dev->evbit);
-        input_set_abs_params(sensor->input_dev, ABS_PRESSURE, sensor->ops->range[0], sensor->ops->range[1], 0, 0);
-        break;
-    default:
-        dev_err(&client->dev, "%s:unknow sensor type=%d\n", __func__, type);
-        break;
-    }
-    sensor->input_dev->dev.parent = &client->dev;
 
-    // 注册输入设备
-    result = input_register_device(sensor->input_dev);
-    if (result) {
-        dev_err(&client->dev,
-            "Unable to register input device %s\n", sensor->input_dev->name);
+    result = sensor_input_init(sensor);
+    if (result)
         goto out_input_register_device_failed;
-    }
 
     /* 中断或延迟工作队列初始化 */
     result = sensor_irq_init(sensor->client);
@@ -1247,17 +3002,20 @@ static int sensor_probe(struct i2c_client *client, const struct i2c_device_id *d
         goto out_input_register_device_failed;
     }
 
+    /* 设备节点创建之后 START 就会调用 pm_runtime_get_sync，runtime PM 需要先使能 */
+    result = sensor_pm_init(sensor);
+    if (result)
+        dev_err(&client->dev, "fail to add pm attributes,ret=%d\n", result);
+
     sensor->miscdev.parent = &client->dev;
     result = sensor_misc_device_register(sensor, type);
     if (result) {
         dev_err(&client->dev,
             "fail to register misc device %s\n", sensor->miscdev.name);
+        sensor_pm_remove(sensor);
         goto out_misc_device_register_device_failed;
     }
 
-    g_sensor[type] = sensor;
-
-
     dev_info(&client->dev, "%s:initialized ok,sensor name:%s,type:%d,id=%d\n\n", __func__, sensor->ops->name, type, (int)sensor->i2c_id->driver_data);
 
     return result;
@@ -1276,8 +3034,10 @@ static int sensor_remove(struct i2c_client *client)
         (struct sensor_private_data *) i2c_get_clientdata(client);
 
     sensor->stop_work = 1;
-    cancel_delayed_work_sync(&sensor->delaywork);
-    misc_deregister(&sensor->miscdev);
+    if (!sensor->pdata->irq_enable)
+        sensor_poll_stop(sensor);
+    sensor_misc_device_unregister(sensor);
+    sensor_pm_remove(sensor);
 
     return 0;
 }
@@ -1304,11 +3064,10 @@ int jason_sensor_register_device(struct i2c_client *client,
         return -EINVAL;
     }
 
-    sensor_ops[ops->id_i2c] = ops;
     dev_info(&client->dev, "%s: %s, id = %d\n",
-        __func__, sensor_ops[ops->id_i2c]->name, ops->id_i2c);
+        __func__, ops->name, ops->id_i2c);
 
-    sensor_probe(client, devid);
+    result = sensor_probe(client, devid, ops);
 
     return result;
 }
@@ -1334,32 +3093,140 @@ int jason_sensor_unregister_device(struct i2c_client *client,
     sensor_remove(client);
 
     dev_info(&client->dev, "%s: %s, id = %d\n",
-        __func__, sensor_ops[ops->id_i2c]->name, ops->id_i2c);
-    sensor_ops[ops->id_i2c] = NULL;
+        __func__, ops->name, ops->id_i2c);
 
     return result;
 }
 EXPORT_SYMBOL(jason_sensor_unregister_device);
 
+/**
+ * 为主设备注册一个从设备（companion）。
+ *
+ * 一些芯片在一个 i2c 地址上集成了多个传感器（例如 6 轴 IMU 的加速度计、陀螺仪和温度传感器），
+ * 从设备与主设备共用 client、pdata 以及主设备的采集（中断或轮询），但拥有自己的输入设备、
+ * misc 设备和数据环形缓冲区。主设备的 report 负责读取数据并分发给从设备。
+ * 从设备的 ops 不需要 init/report，ops->active 可选，在从设备被打开或关闭时调用。
+ * private_data 在设备节点创建之前设置，打开设备后的 ops 回调都能使用它。
+ */
+struct sensor_private_data *jason_sensor_register_companion(struct i2c_client *client,
+        struct sensor_operate *ops, void *private_data)
+{
+    struct sensor_private_data *master;
+    struct sensor_private_data *sensor;
+    int result;
+
+    if (!client || !ops)
+        return ERR_PTR(-ENODEV);
+
+    master = (struct sensor_private_data *) i2c_get_clientdata(client);
+    if (!master || master->master) {
+        dev_err(&client->dev, "%s: %s has no master sensor\n", __func__, ops->name);
+        return ERR_PTR(-ENODEV);
+    }
+
+    if ((ops->type >= SENSOR_NUM_TYPES) || (ops->type <= SENSOR_TYPE_NULL) ||
+        (ops->type == master->type)) {
+        dev_err(&client->dev, "%s: %s type is error %d\n", __func__, ops->name, ops->type);
+        return ERR_PTR(-EINVAL);
+    }
+
+    sensor = devm_kzalloc(&client->dev, sizeof(*sensor), GFP_KERNEL);
+    if (!sensor)
+        return ERR_PTR(-ENOMEM);
+
+    sensor->client = client;
+    sensor->pdata = master->pdata;
+    sensor->type = ops->type;
+    sensor->i2c_id = master->i2c_id;
+    sensor->devid = master->devid;
+    sensor->ops = ops;
+    sensor->master = master;
+    sensor->period_us = master->period_us;
+    sensor->private_data = private_data;
+
+    result = sensor_data_init(sensor);
+    if (result)
+        goto error;
+
+    result = sensor_input_init(sensor);
+    if (result)
+        goto error;
+
+    result = sensor_misc_device_register(sensor, sensor->type);
+    if (result)
+        goto error;
+
+    mutex_lock(&master->operation_mutex);
+    list_add_tail(&sensor->companion_node, &master->companions);
+    mutex_unlock(&master->operation_mutex);
+
+    dev_info(&client->dev, "%s:initialized ok,sensor name:%s,type:%d,master:%s\n", __func__,
+        ops->name, sensor->type, master->ops->name);
+
+    return sensor;
+
+error:
+    dev_err(&client->dev, "%s: %s failed %d\n", __func__, ops->name, result);
+    return ERR_PTR(result);
+}
+EXPORT_SYMBOL(jason_sensor_register_companion);
+
+/**
+ * 注销从设备，需在主设备注销之后调用，此时采集已经停止。
+ * 内存和输入设备由 devm 在 client 解绑时释放。
+ */
+void jason_sensor_unregister_companion(struct sensor_private_data *sensor)
+{
+    if (IS_ERR_OR_NULL(sensor))
+        return;
+
+    mutex_lock(&sensor->master->operation_mutex);
+    list_del_init(&sensor->companion_node);
+    mutex_unlock(&sensor->master->operation_mutex);
+
+    sensor_misc_device_unregister(sensor);
+}
+EXPORT_SYMBOL(jason_sensor_unregister_companion);
+
 /**********************************General**************************************/
 
 static int sensor_class_init(void)
 {
     jason_sensor_class = class_create(THIS_MODULE, "jason_sensor_class");
+    if (IS_ERR(jason_sensor_class))
+        return PTR_ERR(jason_sensor_class);
+    jason_sensor_class->dev_groups = sensor_stats_groups;
 
     return 0;
 }
 
 static int __init sensor_init(void)
 {
-    sensor_class_init();
+    int result;
+    int i;
+
+    for (i = 0; i < SENSOR_NUM_TYPES; i++)
+        ida_init(&sensor_ida[i]);
+
+    result = sensor_class_init();
+    if (result) {
+        for (i = 0; i < SENSOR_NUM_TYPES; i++)
+            ida_destroy(&sensor_ida[i]);
+        return result;
+    }
+    sensor_debugfs_root = debugfs_create_dir("jason_sensor", NULL);
 
     return 0;
 }
  
 static void __exit sensor_exit(void)
 {
+    int i;
+
+    debugfs_remove_recursive(sensor_debugfs_root);
     class_destroy(jason_sensor_class);
+    for (i = 0; i < SENSOR_NUM_TYPES; i++)
+        ida_destroy(&sensor_ida[i]);
 }
  
 module_init(sensor_init);
@@ -4,6 +4,12 @@
 #include <linux/miscdevice.h>
 #include <dt-bindings/sensor-dev.h>
 #include <linux/module.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/seqlock.h>
+#include <linux/list.h>
+#include <linux/pm.h>
+#include "jason_sensor_uapi.h"
 
 #define SENSOR_ON		1
 #define SENSOR_OFF		0
@@ -110,10 +116,38 @@ enum sensor_id {
     SENSOR_NUM_ID_HIGH,
 };
 
-struct sensor_axis {
-    int x;
-    int y;
-    int z;
+#define SENSOR_POLL_PERIOD_MIN_US	1000	/* 轮询周期范围，最高 1kHz */
+#define SENSOR_POLL_PERIOD_MAX_US	1000000
+#define SENSOR_AUTOSUSPEND_DELAY_MS	2000	/* 默认 autosuspend 延时 */
+#define SENSOR_PROBE_RETRY		3	/* reprobe_en 时芯片无响应最多尝试的次数 */
+#define SENSOR_PROBE_RETRY_DELAY_MS	100
+
+#define SENSOR_EVENTS_PER_SAMPLE	5	/* 三个轴 + MSC_TIMESTAMP + SYN_REPORT */
+
+#define SENSOR_RING_SIZE		512	/* 环形缓冲区样本数，必须是 2 的幂 */
+
+/* 每个传感器一个样本环，由上报路径写入，通过 read()/poll()/mmap() 读取 */
+struct sensor_ring {
+    struct sensor_ring_header *hdr;	/* vmalloc_user 分配，头部 + 样本数组 */
+    struct sensor_sample *buf;
+    unsigned int size;
+    size_t mmap_size;
+    wait_queue_head_t wq;
+};
+
+/* log2 直方图的桶数：第 0 桶为 0ns，第 k 桶为 [2^(k-1), 2^k) ns，最后一桶包含更大的值 */
+#define SENSOR_HIST_BUCKETS		32
+
+/*
+ * 性能计数，每个 CPU 一份，热路径上只在关抢占时加本 CPU 的计数，不用原子操作，
+ * 读取时对所有 CPU 求和，见 debugfs 的 jason_sensor/<设备名>/stats 和 jason_sensor_class 下的属性。
+ */
+struct sensor_stats {
+    u64 samples;		/* 发布到样本环的样本数 */
+    u64 i2c_xfers;		/* 主设备：i2c 读传输次数 */
+    u64 i2c_errors;		/* 主设备：失败的 i2c 读传输次数 */
+    u64 i2c_hist[SENSOR_HIST_BUCKETS];		/* 主设备：i2c 读传输耗时 */
+    u64 latency_hist[SENSOR_HIST_BUCKETS];	/* 采集时刻（中断模式为中断时刻）到发布的延时 */
 };
 
 struct sensor_flag {
@@ -126,6 +160,8 @@ struct sensor_flag {
     wait_queue_head_t open_wq;
 };
 
+struct sensor_private_data;
+
 struct sensor_operate {
     char *name;
     int type;
@@ -147,26 +183,75 @@ struct sensor_operate {
     int (*report)(struct i2c_client *client);
     int (*suspend)(struct i2c_client *client);
     int (*resume)(struct i2c_client *client);
+    /* 采集运行中修改该功能的上报周期（us），不停止采集；为 NULL 时只按周期降频上报 */
+    int (*set_rate)(struct sensor_private_data *sensor, int period_us);
+    /* 芯片支持的 SENSOR_EVENT_* 事件，只对主设备有效 */
+    unsigned int events;
+    /* 设置使能的事件，采集的使用者变化时也会调用，用来重新决定是否需要数据中断 */
+    int (*set_events)(struct sensor_private_data *sensor, unsigned int events);
     struct miscdevice *misc_dev;
 };
 
+/*
+ * 符号扩展、校准、坐标变换和单位换算合并后的系数，
+ * layout 只会产生带符号的置换矩阵，每个输出轴只来自芯片的一个轴，一次减法和一次乘法即可。
+ */
+struct sensor_xform {
+    unsigned char src[3];	/* 输出轴对应的芯片轴 */
+    int bias[3];		/* 按输出轴排列，单位为原始 LSB */
+    int gain[3];		/* Q16，包含方向符号、校准增益和单位换算 */
+};
+
 /* Private data for the sensor */
 struct sensor_private_data {
     int type;
     struct i2c_client *client;
     struct input_dev *input_dev;
     int stop_work;
-    struct delayed_work delaywork; // 延迟执行的工作
+    struct hrtimer poll_timer;	/* 轮询模式下按绝对时间周期触发，避免 jiffies 取整和累积漂移 */
+    struct kthread_worker *worker;	/* 每个传感器独立的采集线程，不与 system_wq 上的其他工作互相影响 */
+    struct kthread_work poll_work;	/* 由 poll_timer 提交到 worker，在进程上下文中读取数据 */
+    ktime_t poll_period;		/* 轮询周期 */
+    atomic_t poll_missed;		/* 错过的轮询周期数 */
+    u32 acq_seq;		/* 主设备：采集序号，每次轮询或中断加一，跟踪点用它对齐同一次采集的事件 */
+    int poll_missed_reported;
+    int period_us;		/* 该功能请求的上报周期，主设备的轮询周期取已打开功能中最短的 */
+    ktime_t next_report;	/* 采集比请求的周期快时，到这个时刻才上报下一个样本 */
     struct sensor_axis axis;
+    struct sensor_quat quat;	/* 角度传感器：最新的姿态四元数，与 axis 一起由 axis_lock 保护 */
+    ktime_t timestamp;		/* 本次采集的时间戳，在调用 ops->report 之前记录 */
+    ktime_t irq_timestamp;	/* 中断上半部记录的时间戳，中断模式下作为本次采集的时间戳 */
+    struct sensor_ring ring;
     char sensor_data[40];
     atomic_t is_factory;
     wait_queue_head_t is_factory_ok;
-    struct mutex data_mutex;
+    struct sensor_calib calib;	/* 当前使用的校准参数 */
+    struct sensor_xform xform;	/* 由 calib、layout 和 scale_nano 计算，在主设备的 sensor_mutex 中读写 */
+    int scale_nano;		/* 1 LSB 对应的 SI 单位大小（n m/s^2、n rad/s），0 表示未知 */
+    int calib_loaded;		/* 是否已经尝试从 vendor storage 读取校准参数 */
+    struct sensor_tcomp tcomp;	/* 零偏的温度补偿表，在主设备的 sensor_mutex 中读写 */
+    int temp_mdeg;		/* 上一次计算温度补偿时的温度 */
+    int tbias[3];		/* temp_mdeg 对应的额外零偏，芯片坐标系 */
+    int probe_times;		/* 本实例 probe 时已尝试初始化芯片的次数 */
+    int resume_latency_us;	/* 主设备：最近一次 runtime resume 的耗时 */
+    int resume_latency_max_us;	/* 主设备：runtime resume 耗时的最大值 */
+    struct sensor_stats __percpu *stats;
+    atomic_t readers;		/* 打开 misc 设备的文件数 */
+    struct device *class_dev;	/* jason_sensor_class 下的设备，用于导出性能计数 */
+    struct dentry *debugfs;
+    seqlock_t axis_lock;	/* 保护 axis：发布者只在写 axis 时短暂持有，读者无锁重试，不会阻塞发布者 */
     struct mutex operation_mutex;
     struct mutex sensor_mutex; // 用于确保传感器数据上报互斥
     struct mutex i2c_mutex;
-    int status_cur;
+    int status_cur;		/* 当前功能是否被打开 */
     int start_count;
+    int acq_period_us;		/* 主设备：其他数据通道（例如 IIO）请求的轮询周期，0 表示没有，在 operation_mutex 中读写 */
+    int acq_count;		/* 主设备的采集被多少个功能（主设备或从设备）使用，使能了事件时也算一个 */
+    unsigned int events;	/* 至少一个打开的文件使能了的事件 */
+    int event_count[SENSOR_EVENT_NUM];	/* 每种事件被多少个打开的文件使能 */
+    struct sensor_private_data *master;	/* 从设备指向共用 i2c client 的主设备，主设备为 NULL */
+    struct list_head companions;	/* 主设备：已注册的从设备，在主设备的 operation_mutex 中修改 */
+    struct list_head companion_node;
     int devid;
     struct sensor_flag flags;
     struct i2c_device_id *i2c_id;
@@ -174,6 +259,9 @@ struct sensor_private_data {
     struct sensor_operate *ops;
     struct file_operations fops;
     struct miscdevice miscdev;
+    int index;			/* 同类型传感器中的实例编号 */
+    char misc_name[32];		/* index 不为 0 时 misc 设备的名字 */
+    void *private_data;		/* 具体传感器驱动的私有数据，一般在 ops->init 中分配 */
 };
 
 struct sensor_platform_data {
@@ -185,6 +273,13 @@ struct sensor_platform_data {
     int standby_pin;
     int irq_enable; // 是否使能中断
     int poll_delay_ms;
+    int poll_period_us;		/* 轮询周期，单位：us，优先于 poll_delay_ms */
+    int rt_priority;		/* 采集线程的 SCHED_FIFO 优先级，0 表示普通线程 */
+    int cpu_affinity;		/* 采集线程绑定的 CPU，-1 表示不绑定 */
+    int odr_hz;			/* 芯片输出数据率，0 表示使用驱动默认值 */
+    int fifo_watermark;		/* 硬件 FIFO 水位线，单位：帧，0 表示不使用 FIFO */
+    int si_units;		/* 加速度计和陀螺仪按 um/s^2、urad/s 上报，0 表示上报原始值 */
+    int autosuspend_delay_ms;	/* 全部功能关闭后经过这段时间调用 ops->suspend，-1 表示不自动挂起 */
     int x_min;
     int y_min;
     int z_min;
@@ -228,62 +323,6 @@ struct akm_platform_data {
 
 #define DBG(x...)
 
-#define SENSOR_ACCEL_IOCTL_MAGIC			'a'
-#define GBUFF_SIZE				12	/* Rx buffer size */
-
-/* IOCTLs for sensor accel library */
-#define SENSOR_ACCEL_IOCTL_CLOSE					_IO(SENSOR_ACCEL_IOCTL_MAGIC, 0x02)
-#define SENSOR_ACCEL_IOCTL_START					_IO(SENSOR_ACCEL_IOCTL_MAGIC, 0x03)
-#define SENSOR_ACCEL_IOCTL_GETDATA					_IOR(SENSOR_ACCEL_IOCTL_MAGIC, 0x08, char[GBUFF_SIZE+1])
-#define SENSOR_ACCEL_IOCTL_SET_RATE			        _IOW(SENSOR_ACCEL_IOCTL_MAGIC, 0x10, short)
-
-#define SENSOR_GYRO_IOCTL_MAGIC			'g'
-#define GBUFF_SIZE				12	/* Rx buffer size */
-
-/* IOCTLs for sensor accel library */
-#define SENSOR_GYRO_IOCTL_CLOSE					_IO(SENSOR_GYRO_IOCTL_MAGIC, 0x02)
-#define SENSOR_GYRO_IOCTL_START					_IO(SENSOR_GYRO_IOCTL_MAGIC, 0x03)
-#define SENSOR_GYRO_IOCTL_GETDATA					_IOR(SENSOR_GYRO_IOCTL_MAGIC, 0x08, char[GBUFF_SIZE+1])
-#define SENSOR_GYRO_IOCTL_SET_RATE			        _IOW(SENSOR_GYRO_IOCTL_MAGIC, 0x10, short)
-
-#define COMPASS_IOCTL_MAGIC					'c'
-/* IOCTLs for APPs */
-#define ECS_IOCTL_APP_SET_MODE				_IOW(COMPASS_IOCTL_MAGIC, 0x10, short)
-#define ECS_IOCTL_APP_SET_MFLAG				_IOW(COMPASS_IOCTL_MAGIC, 0x11, short)
-#define ECS_IOCTL_APP_GET_MFLAG				_IOW(COMPASS_IOCTL_MAGIC, 0x12, short)
-#define ECS_IOCTL_APP_SET_AFLAG				_IOW(COMPASS_IOCTL_MAGIC, 0x13, short)
-#define ECS_IOCTL_APP_GET_AFLAG				_IOR(COMPASS_IOCTL_MAGIC, 0x14, short)
-#define ECS_IOCTL_APP_SET_TFLAG				_IOR(COMPASS_IOCTL_MAGIC, 0x15, short)/* NOT use */
-#define ECS_IOCTL_APP_GET_TFLAG				_IOR(COMPASS_IOCTL_MAGIC, 0x16, short)/* NOT use */
-#define ECS_IOCTL_APP_RESET_PEDOMETER		_IOW(COMPASS_IOCTL_MAGIC, 0x17)	/* NOT use */
-#define ECS_IOCTL_APP_SET_DELAY				_IOW(COMPASS_IOCTL_MAGIC, 0x18, short)
-#define ECS_IOCTL_APP_SET_MVFLAG				_IOW(COMPASS_IOCTL_MAGIC, 0x19, short)
-#define ECS_IOCTL_APP_GET_MVFLAG				_IOR(COMPASS_IOCTL_MAGIC, 0x1A, short)
-#define ECS_IOCTL_APP_GET_DELAY				_IOR(COMPASS_IOCTL_MAGIC, 0x1B, short)
-
-#define LIGHTSENSOR_IOCTL_MAGIC					'l'
-#define LIGHTSENSOR_IOCTL_GET_ENABLED			_IOR(LIGHTSENSOR_IOCTL_MAGIC, 1, int *)
-#define LIGHTSENSOR_IOCTL_ENABLE					_IOW(LIGHTSENSOR_IOCTL_MAGIC, 2, int *)
-#define LIGHTSENSOR_IOCTL_SET_RATE				_IOW(LIGHTSENSOR_IOCTL_MAGIC, 3, short)
-
-#define PSENSOR_IOCTL_MAGIC				'p'
-#define PSENSOR_IOCTL_GET_ENABLED		_IOR(PSENSOR_IOCTL_MAGIC, 1, int *)
-#define PSENSOR_IOCTL_ENABLE				_IOW(PSENSOR_IOCTL_MAGIC, 2, int *)
-#define PSENSOR_IOCTL_DISABLE				_IOW(PSENSOR_IOCTL_MAGIC, 3, int *)
-
-#define PRESSURE_IOCTL_MAGIC 				'r'
-#define PRESSURE_IOCTL_GET_ENABLED		_IOR(PRESSURE_IOCTL_MAGIC, 1, int *)
-#define PRESSURE_IOCTL_ENABLE				_IOW(PRESSURE_IOCTL_MAGIC, 2, int *)
-#define PRESSURE_IOCTL_DISABLE			_IOW(PRESSURE_IOCTL_MAGIC, 3, int *)
-#define PRESSURE_IOCTL_SET_DELAY			_IOW(PRESSURE_IOCTL_MAGIC, 4, int *)
-
-#define TEMPERATURE_IOCTL_MAGIC			't'
-#define TEMPERATURE_IOCTL_GET_ENABLED	_IOR(TEMPERATURE_IOCTL_MAGIC, 1, int *)
-#define TEMPERATURE_IOCTL_ENABLE			_IOW(TEMPERATURE_IOCTL_MAGIC, 2, int *)
-#define TEMPERATURE_IOCTL_DISABLE		_IOW(TEMPERATURE_IOCTL_MAGIC, 3, int *)
-#define TEMPERATURE_IOCTL_SET_DELAY		_IOW(TEMPERATURE_IOCTL_MAGIC, 4, int *)
-
-
 extern int sensor_rx_data(struct i2c_client *client, char *rxData, int length);
 extern int sensor_tx_data(struct i2c_client *client, char *txData, int length);
 extern int sensor_write_reg(struct i2c_client *client, int addr, int value);
@@ -301,5 +340,27 @@ extern int jason_sensor_unregister_device(struct i2c_client *client,
         struct sensor_platform_data *slave_pdata,
         struct sensor_operate *ops);
 extern void jason_sensor_shutdown(struct i2c_client *client);
+extern struct sensor_private_data *jason_sensor_register_companion(struct i2c_client *client,
+        struct sensor_operate *ops, void *private_data);
+extern void jason_sensor_unregister_companion(struct sensor_private_data *sensor);
+extern int jason_sensor_acquire(struct sensor_private_data *sensor, int enable);
+extern void jason_sensor_set_acquire_period(struct sensor_private_data *sensor, unsigned int period_us);
+extern int jason_sensor_pm_get(struct sensor_private_data *sensor);
+extern void jason_sensor_pm_put(struct sensor_private_data *sensor);
+extern void jason_sensor_publish(struct sensor_private_data *sensor,
+        const struct sensor_axis *axis, ktime_t timestamp);
+extern void jason_sensor_publish_quat(struct sensor_private_data *sensor,
+        const int *q, ktime_t timestamp);
+extern void jason_sensor_input_sync(struct sensor_private_data *sensor, ktime_t timestamp);
+extern void jason_sensor_report_event(struct sensor_private_data *sensor,
+            unsigned int event, ktime_t timestamp);
+extern void jason_sensor_convert(struct sensor_private_data *sensor,
+        const uint8_t *buf, struct sensor_axis *axis);
+extern void jason_sensor_set_scale(struct sensor_private_data *sensor, int scale_nano);
+extern void jason_sensor_set_temperature(struct sensor_private_data *sensor, int temp_mdeg);
+extern int jason_sensor_due(ktime_t *next, s64 period_ns, ktime_t timestamp);
+extern int jason_sensor_sample_due(struct sensor_private_data *sensor, ktime_t timestamp);
+extern void jason_sensor_stat_i2c(struct sensor_private_data *sensor, ktime_t start, int ret);
+extern const struct dev_pm_ops jason_sensor_pm_ops;
  
 #endif
\ No newline at end of file
@@ -0,0 +1,191 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM jason_sensor
+
+#if !defined(__JASON_SENSOR_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __JASON_SENSOR_TRACE_H__
+
+#include <linux/tracepoint.h>
+#include "jason_sensor_dev.h"
+
+/*
+ * 采集路径上的跟踪点，按时间顺序：
+ *   schedule   轮询定时器提交采集 / 中断上半部唤醒中断线程
+ *   wakeup     采集线程或中断线程开始执行本次采集
+ *   i2c_start、i2c_end   一次 i2c 读传输的开始和结束，带字节数和返回值
+ *   transform  原始值转换为上报值
+ *   report     input 事件上报
+ *   publish    样本写入样本环，带样本环序号和采集到发布的延时
+ * 每个事件都带传感器名字、实例编号和主设备的采集序号 acq_seq，同一次采集的事件序号相同，
+ * 用 trace-cmd/perf 按序号对齐即可把延时拆分到定时器、调度、i2c 和驱动处理上。
+ */
+
+/* 采集状态保存在主设备中，从设备的事件也使用主设备的采集序号 */
+#define JASON_SENSOR_ACQ_SEQ(sensor) \
+    ((sensor)->master ? (sensor)->master->acq_seq : (sensor)->acq_seq)
+
+DECLARE_EVENT_CLASS(jason_sensor_acq,
+    TP_PROTO(struct sensor_private_data *sensor, u32 seq),
+    TP_ARGS(sensor, seq),
+
+    TP_STRUCT__entry(
+        __string(name, sensor->ops->name)
+        __field(int, index)
+        __field(u32, seq)
+    ),
+
+    TP_fast_assign(
+        __assign_str(name, sensor->ops->name);
+        __entry->index = sensor->index;
+        __entry->seq = seq;
+    ),
+
+    TP_printk("%s%d seq=%u", __get_str(name), __entry->index, __entry->seq)
+);
+
+/* seq 为即将进行的采集的序号 */
+DEFINE_EVENT(jason_sensor_acq, jason_sensor_schedule,
+    TP_PROTO(struct sensor_private_data *sensor, u32 seq),
+    TP_ARGS(sensor, seq)
+);
+
+DEFINE_EVENT(jason_sensor_acq, jason_sensor_wakeup,
+    TP_PROTO(struct sensor_private_data *sensor, u32 seq),
+    TP_ARGS(sensor, seq)
+);
+
+TRACE_EVENT(jason_sensor_i2c_start,
+    TP_PROTO(struct sensor_private_data *sensor, u8 reg, int len),
+    TP_ARGS(sensor, reg, len),
+
+    TP_STRUCT__entry(
+        __string(name, sensor->ops->name)
+        __field(int, index)
+        __field(u32, seq)
+        __field(u8, reg)
+        __field(int, len)
+    ),
+
+    TP_fast_assign(
+        __assign_str(name, sensor->ops->name);
+        __entry->index = sensor->index;
+        __entry->seq = JASON_SENSOR_ACQ_SEQ(sensor);
+        __entry->reg = reg;
+        __entry->len = len;
+    ),
+
+    TP_printk("%s%d seq=%u reg=0x%02x len=%d", __get_str(name), __entry->index,
+        __entry->seq, __entry->reg, __entry->len)
+);
+
+TRACE_EVENT(jason_sensor_i2c_end,
+    TP_PROTO(struct sensor_private_data *sensor, u8 reg, int len, int ret),
+    TP_ARGS(sensor, reg, len, ret),
+
+    TP_STRUCT__entry(
+        __string(name, sensor->ops->name)
+        __field(int, index)
+        __field(u32, seq)
+        __field(u8, reg)
+        __field(int, len)
+        __field(int, ret)
+    ),
+
+    TP_fast_assign(
+        __assign_str(name, sensor->ops->name);
+        __entry->index = sensor->index;
+        __entry->seq = JASON_SENSOR_ACQ_SEQ(sensor);
+        __entry->reg = reg;
+        __entry->len = len;
+        __entry->ret = ret;
+    ),
+
+    TP_printk("%s%d seq=%u reg=0x%02x len=%d ret=%d", __get_str(name), __entry->index,
+        __entry->seq, __entry->reg, __entry->len, __entry->ret)
+);
+
+TRACE_EVENT(jason_sensor_transform,
+    TP_PROTO(struct sensor_private_data *sensor, const int *raw, const struct sensor_axis *axis),
+    TP_ARGS(sensor, raw, axis),
+
+    TP_STRUCT__entry(
+        __string(name, sensor->ops->name)
+        __field(int, index)
+        __field(u32, seq)
+        __array(int, raw, 3)
+        __field(int, x)
+        __field(int, y)
+        __field(int, z)
+    ),
+
+    TP_fast_assign(
+        __assign_str(name, sensor->ops->name);
+        __entry->index = sensor->index;
+        __entry->seq = JASON_SENSOR_ACQ_SEQ(sensor);
+        memcpy(__entry->raw, raw, sizeof(__entry->raw));
+        __entry->x = axis->x;
+        __entry->y = axis->y;
+        __entry->z = axis->z;
+    ),
+
+    TP_printk("%s%d seq=%u raw=%d,%d,%d out=%d,%d,%d", __get_str(name), __entry->index,
+        __entry->seq, __entry->raw[0], __entry->raw[1], __entry->raw[2],
+        __entry->x, __entry->y, __entry->z)
+);
+
+TRACE_EVENT(jason_sensor_report,
+    TP_PROTO(struct sensor_private_data *sensor, ktime_t timestamp),
+    TP_ARGS(sensor, timestamp),
+
+    TP_STRUCT__entry(
+        __string(name, sensor->ops->name)
+        __field(int, index)
+        __field(u32, seq)
+        __field(s64, timestamp)
+    ),
+
+    TP_fast_assign(
+        __assign_str(name, sensor->ops->name);
+        __entry->index = sensor->index;
+        __entry->seq = JASON_SENSOR_ACQ_SEQ(sensor);
+        __entry->timestamp = ktime_to_ns(timestamp);
+    ),
+
+    TP_printk("%s%d seq=%u timestamp=%lld", __get_str(name), __entry->index,
+        __entry->seq, __entry->timestamp)
+);
+
+TRACE_EVENT(jason_sensor_publish,
+    TP_PROTO(struct sensor_private_data *sensor, u32 ring_seq, ktime_t timestamp),
+    TP_ARGS(sensor, ring_seq, timestamp),
+
+    TP_STRUCT__entry(
+        __string(name, sensor->ops->name)
+        __field(int, index)
+        __field(u32, seq)
+        __field(u32, ring_seq)
+        __field(s64, timestamp)
+        __field(s64, latency_ns)
+    ),
+
+    TP_fast_assign(
+        __assign_str(name, sensor->ops->name);
+        __entry->index = sensor->index;
+        __entry->seq = JASON_SENSOR_ACQ_SEQ(sensor);
+        __entry->ring_seq = ring_seq;
+        __entry->timestamp = ktime_to_ns(timestamp);
+        __entry->latency_ns = ktime_to_ns(ktime_sub(ktime_get_boottime(), timestamp));
+    ),
+
+    TP_printk("%s%d seq=%u ring_seq=%u timestamp=%lld latency=%lldns", __get_str(name),
+        __entry->index, __entry->seq, __entry->ring_seq, __entry->timestamp,
+        __entry->latency_ns)
+);
+
+#endif /* __JASON_SENSOR_TRACE_H__ */
+
+/* 本头文件不在 include/trace/events 下，由 Makefile 把源码目录加入头文件搜索路径 */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE jason_sensor_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,189 @@
+#ifndef __JASON_SENSOR_UAPI_H__
+#define __JASON_SENSOR_UAPI_H__
+
+/*
+ * 传感器 misc 设备的用户态接口：样本格式、样本环布局和 ioctl 命令。
+ * 内核驱动和用户态程序（libjason_sensor）共用这一份定义，用户态不要再自己声明。
+ */
+
+#include <linux/ioctl.h>
+
+struct sensor_axis {
+    int x;
+    int y;
+    int z;
+};
+
+/* 角度传感器的姿态四元数 w x y z，Q30（SENSOR_QUAT_ONE 为 1.0），timestamp 为 CLOCK_BOOTTIME ns */
+#define SENSOR_QUAT_ONE		(1 << 30)
+struct sensor_quat {
+    long long timestamp;
+    int q[4];
+};
+
+/* 芯片检测的事件：*_IOCTL_SET_EVENTS 的位掩码，检测到时作为 MSC_GESTURE 的值上报 */
+#define SENSOR_EVENT_SINGLE_TAP		(1 << 0)
+#define SENSOR_EVENT_DOUBLE_TAP		(1 << 1)
+#define SENSOR_EVENT_FREE_FALL		(1 << 2)
+#define SENSOR_EVENT_HIGH_G		(1 << 3)
+#define SENSOR_EVENT_ORIENT		(1 << 4)
+#define SENSOR_EVENT_FLAT		(1 << 5)
+#define SENSOR_EVENT_NUM		6
+
+#define SENSOR_SAMPLE_FLAG_OVERRUN	(1 << 0)	/* 该样本之前有样本因读取过慢被覆盖 */
+
+/* 带时间戳的样本，misc 设备 read() 返回的就是该结构体数组 */
+struct sensor_sample {
+    long long timestamp;	/* 采集时刻，CLOCK_BOOTTIME，单位 ns */
+    unsigned int seq;		/* 样本序号，连续递增 */
+    unsigned int flags;		/* SENSOR_SAMPLE_FLAG_* */
+    struct sensor_axis axis;
+    int reserved;
+};
+
+#define SENSOR_BATCH_WAIT		(1 << 0)	/* 没有样本时阻塞到至少有一个样本，O_NONBLOCK 时返回 -EAGAIN */
+
+/* *_IOCTL_GET_BATCH 的参数，一次系统调用读取多个带时间戳的样本 */
+struct sensor_batch {
+    unsigned long long samples;	/* 输入：用户态 struct sensor_sample 数组的地址 */
+    unsigned int max;		/* 输入：数组长度 */
+    unsigned int flags;		/* 输入：SENSOR_BATCH_* */
+    unsigned int count;		/* 输出：取出的样本数 */
+    unsigned int dropped;	/* 输出：本次调用期间因读取过慢丢失的样本数 */
+};
+
+#define SENSOR_CALIB_ONE		(1 << 16)	/* 校准增益 1.0，Q16 定点 */
+#define SENSOR_CALIB_SCALE_MAX		(4 << 16)
+
+/*
+ * 校准参数，使用芯片坐标系（不随 layout 改变），输出 = (原始值 - bias) * scale。
+ * bias 单位为原始 LSB，scale 为 Q16 增益。
+ */
+struct sensor_calib {
+    int bias[3];
+    int scale[3];
+};
+
+#define SENSOR_TCOMP_POINTS		8
+
+/*
+ * 零偏的温度补偿表，在 calib.bias 之外再减去按温度插值得到的零偏，同样使用芯片坐标系。
+ * 各点按温度从低到高排列，点之间线性插值，超出范围时取两端的值。
+ */
+struct sensor_tcomp {
+    int count;				/* 有效点数，0 表示不补偿 */
+    int temp[SENSOR_TCOMP_POINTS];	/* 温度，单位 0.001°C */
+    int bias[SENSOR_TCOMP_POINTS][3];	/* 该温度下的额外零偏，单位为原始 LSB */
+};
+
+#define SENSOR_RING_MAGIC		0x53524e47	/* "SRNG" */
+#define SENSOR_RING_VERSION		1
+#define SENSOR_SAMPLE_FMT_AXIS		1	/* 样本为 struct sensor_sample，axis 为 x/y/z 三轴 */
+
+/*
+ * 样本环的头部，位于 mmap 映射的第一页，样本数组从 data_offset 开始。
+ *
+ * 内核是唯一的写者，写入序号为 n 的样本时：
+ *   1. 把槽位 n % capacity 的 seq 改成 n - 1（表示正在写，不等于任何读者期望的值）
+ *   2. 写入 timestamp/flags/axis
+ *   3. 把槽位的 seq 改成 n，再把 write_seq 更新为 n + 1
+ * 读者（read() 或 mmap 的用户态程序）读取序号 s 的样本时：
+ *   1. s == write_seq 表示没有新样本；write_seq - s > capacity 表示丢失了样本
+ *   2. 拷贝槽位前后各读一次 seq，两次都等于 s 才说明拷贝到的是完整样本，
+ *      否则该样本在拷贝过程中被覆盖，应跳到 write_seq - capacity 重新读取
+ * poll() 按文件自己的读取位置判断是否有新样本，mmap 读者在 poll() 之前用
+ * lseek(fd, s, SEEK_SET) 把读取位置同步为自己下一个要读的序号。
+ */
+struct sensor_ring_header {
+    unsigned int magic;		/* SENSOR_RING_MAGIC */
+    unsigned int version;	/* SENSOR_RING_VERSION */
+    unsigned int format;	/* SENSOR_SAMPLE_FMT_* */
+    unsigned int sample_size;	/* sizeof(struct sensor_sample) */
+    unsigned int capacity;	/* 样本数，2 的幂 */
+    unsigned int data_offset;	/* 样本数组相对映射起点的偏移，单位字节 */
+    unsigned int write_seq;	/* 下一个要写入样本的序号 */
+    unsigned int overruns;	/* read() 读者因读取过慢丢失的样本总数 */
+};
+
+#define SENSOR_ACCEL_IOCTL_MAGIC			'a'
+#define GBUFF_SIZE				12	/* Rx buffer size */
+
+/* IOCTLs for sensor accel library */
+#define SENSOR_ACCEL_IOCTL_CLOSE					_IO(SENSOR_ACCEL_IOCTL_MAGIC, 0x02)
+#define SENSOR_ACCEL_IOCTL_START					_IO(SENSOR_ACCEL_IOCTL_MAGIC, 0x03)
+#define SENSOR_ACCEL_IOCTL_GETDATA					_IOR(SENSOR_ACCEL_IOCTL_MAGIC, 0x08, char[GBUFF_SIZE+1])
+#define SENSOR_ACCEL_IOCTL_SET_RATE			        _IOW(SENSOR_ACCEL_IOCTL_MAGIC, 0x10, short)
+#define SENSOR_ACCEL_IOCTL_SET_PERIOD_US			_IOW(SENSOR_ACCEL_IOCTL_MAGIC, 0x11, unsigned int)
+#define SENSOR_ACCEL_IOCTL_GET_POLL_MISSED			_IOR(SENSOR_ACCEL_IOCTL_MAGIC, 0x12, unsigned int)
+#define SENSOR_ACCEL_IOCTL_GET_BATCH				_IOWR(SENSOR_ACCEL_IOCTL_MAGIC, 0x13, struct sensor_batch)
+#define SENSOR_ACCEL_IOCTL_SET_CALIB				_IOW(SENSOR_ACCEL_IOCTL_MAGIC, 0x14, struct sensor_calib)
+#define SENSOR_ACCEL_IOCTL_GET_CALIB				_IOR(SENSOR_ACCEL_IOCTL_MAGIC, 0x15, struct sensor_calib)
+#define SENSOR_ACCEL_IOCTL_SET_EVENTS				_IOW(SENSOR_ACCEL_IOCTL_MAGIC, 0x16, unsigned int)
+#define SENSOR_ACCEL_IOCTL_GET_EVENTS				_IOR(SENSOR_ACCEL_IOCTL_MAGIC, 0x17, unsigned int)
+#define SENSOR_ACCEL_IOCTL_SET_TCOMP				_IOW(SENSOR_ACCEL_IOCTL_MAGIC, 0x18, struct sensor_tcomp)
+#define SENSOR_ACCEL_IOCTL_GET_TCOMP				_IOR(SENSOR_ACCEL_IOCTL_MAGIC, 0x19, struct sensor_tcomp)
+
+#define SENSOR_GYRO_IOCTL_MAGIC			'g'
+#define GBUFF_SIZE				12	/* Rx buffer size */
+
+/* IOCTLs for sensor accel library */
+#define SENSOR_GYRO_IOCTL_CLOSE					_IO(SENSOR_GYRO_IOCTL_MAGIC, 0x02)
+#define SENSOR_GYRO_IOCTL_START					_IO(SENSOR_GYRO_IOCTL_MAGIC, 0x03)
+#define SENSOR_GYRO_IOCTL_GETDATA					_IOR(SENSOR_GYRO_IOCTL_MAGIC, 0x08, char[GBUFF_SIZE+1])
+#define SENSOR_GYRO_IOCTL_SET_RATE			        _IOW(SENSOR_GYRO_IOCTL_MAGIC, 0x10, short)
+#define SENSOR_GYRO_IOCTL_SET_PERIOD_US			_IOW(SENSOR_GYRO_IOCTL_MAGIC, 0x11, unsigned int)
+#define SENSOR_GYRO_IOCTL_GET_POLL_MISSED			_IOR(SENSOR_GYRO_IOCTL_MAGIC, 0x12, unsigned int)
+#define SENSOR_GYRO_IOCTL_GET_BATCH				_IOWR(SENSOR_GYRO_IOCTL_MAGIC, 0x13, struct sensor_batch)
+#define SENSOR_GYRO_IOCTL_SET_CALIB				_IOW(SENSOR_GYRO_IOCTL_MAGIC, 0x14, struct sensor_calib)
+#define SENSOR_GYRO_IOCTL_GET_CALIB				_IOR(SENSOR_GYRO_IOCTL_MAGIC, 0x15, struct sensor_calib)
+#define SENSOR_GYRO_IOCTL_SET_TCOMP				_IOW(SENSOR_GYRO_IOCTL_MAGIC, 0x18, struct sensor_tcomp)
+#define SENSOR_GYRO_IOCTL_GET_TCOMP				_IOR(SENSOR_GYRO_IOCTL_MAGIC, 0x19, struct sensor_tcomp)
+
+#define SENSOR_ANGLE_IOCTL_MAGIC		'o'
+
+/* IOCTLs for sensor angle library，GETDATA 为横滚、俯仰、航向，单位 0.001° */
+#define SENSOR_ANGLE_IOCTL_CLOSE					_IO(SENSOR_ANGLE_IOCTL_MAGIC, 0x02)
+#define SENSOR_ANGLE_IOCTL_START					_IO(SENSOR_ANGLE_IOCTL_MAGIC, 0x03)
+#define SENSOR_ANGLE_IOCTL_GETDATA				_IOR(SENSOR_ANGLE_IOCTL_MAGIC, 0x08, struct sensor_axis)
+#define SENSOR_ANGLE_IOCTL_SET_PERIOD_US			_IOW(SENSOR_ANGLE_IOCTL_MAGIC, 0x11, unsigned int)
+#define SENSOR_ANGLE_IOCTL_GET_BATCH				_IOWR(SENSOR_ANGLE_IOCTL_MAGIC, 0x13, struct sensor_batch)
+#define SENSOR_ANGLE_IOCTL_GET_QUAT				_IOR(SENSOR_ANGLE_IOCTL_MAGIC, 0x20, struct sensor_quat)
+
+#define COMPASS_IOCTL_MAGIC					'c'
+/* IOCTLs for APPs */
+#define ECS_IOCTL_APP_SET_MODE				_IOW(COMPASS_IOCTL_MAGIC, 0x10, short)
+#define ECS_IOCTL_APP_SET_MFLAG				_IOW(COMPASS_IOCTL_MAGIC, 0x11, short)
+#define ECS_IOCTL_APP_GET_MFLAG				_IOW(COMPASS_IOCTL_MAGIC, 0x12, short)
+#define ECS_IOCTL_APP_SET_AFLAG				_IOW(COMPASS_IOCTL_MAGIC, 0x13, short)
+#define ECS_IOCTL_APP_GET_AFLAG				_IOR(COMPASS_IOCTL_MAGIC, 0x14, short)
+#define ECS_IOCTL_APP_SET_TFLAG				_IOR(COMPASS_IOCTL_MAGIC, 0x15, short)/* NOT use */
+#define ECS_IOCTL_APP_GET_TFLAG				_IOR(COMPASS_IOCTL_MAGIC, 0x16, short)/* NOT use */
+#define ECS_IOCTL_APP_RESET_PEDOMETER		_IOW(COMPASS_IOCTL_MAGIC, 0x17)	/* NOT use */
+#define ECS_IOCTL_APP_SET_DELAY				_IOW(COMPASS_IOCTL_MAGIC, 0x18, short)
+#define ECS_IOCTL_APP_SET_MVFLAG				_IOW(COMPASS_IOCTL_MAGIC, 0x19, short)
+#define ECS_IOCTL_APP_GET_MVFLAG				_IOR(COMPASS_IOCTL_MAGIC, 0x1A, short)
+#define ECS_IOCTL_APP_GET_DELAY				_IOR(COMPASS_IOCTL_MAGIC, 0x1B, short)
+
+#define LIGHTSENSOR_IOCTL_MAGIC					'l'
+#define LIGHTSENSOR_IOCTL_GET_ENABLED			_IOR(LIGHTSENSOR_IOCTL_MAGIC, 1, int *)
+#define LIGHTSENSOR_IOCTL_ENABLE					_IOW(LIGHTSENSOR_IOCTL_MAGIC, 2, int *)
+#define LIGHTSENSOR_IOCTL_SET_RATE				_IOW(LIGHTSENSOR_IOCTL_MAGIC, 3, short)
+
+#define PSENSOR_IOCTL_MAGIC				'p'
+#define PSENSOR_IOCTL_GET_ENABLED		_IOR(PSENSOR_IOCTL_MAGIC, 1, int *)
+#define PSENSOR_IOCTL_ENABLE				_IOW(PSENSOR_IOCTL_MAGIC, 2, int *)
+#define PSENSOR_IOCTL_DISABLE				_IOW(PSENSOR_IOCTL_MAGIC, 3, int *)
+
+#define PRESSURE_IOCTL_MAGIC 				'r'
+#define PRESSURE_IOCTL_GET_ENABLED		_IOR(PRESSURE_IOCTL_MAGIC, 1, int *)
+#define PRESSURE_IOCTL_ENABLE				_IOW(PRESSURE_IOCTL_MAGIC, 2, int *)
+#define PRESSURE_IOCTL_DISABLE			_IOW(PRESSURE_IOCTL_MAGIC, 3, int *)
+#define PRESSURE_IOCTL_SET_DELAY			_IOW(PRESSURE_IOCTL_MAGIC, 4, int *)
+
+#define TEMPERATURE_IOCTL_MAGIC			't'
+#define TEMPERATURE_IOCTL_GET_ENABLED	_IOR(TEMPERATURE_IOCTL_MAGIC, 1, int *)
+#define TEMPERATURE_IOCTL_ENABLE			_IOW(TEMPERATURE_IOCTL_MAGIC, 2, int *)
+#define TEMPERATURE_IOCTL_DISABLE		_IOW(TEMPERATURE_IOCTL_MAGIC, 3, int *)
+#define TEMPERATURE_IOCTL_SET_DELAY		_IOW(TEMPERATURE_IOCTL_MAGIC, 4, int *)
+
+#endif
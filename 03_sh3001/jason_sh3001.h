@@ -65,6 +65,9 @@
 #define GYRO_CONFIG_4           (0x9F)
 #define GYRO_CONFIG_5           (0xAF)
 
+/* Power Mode，厂商参考代码 SwitchPowerMode 中的模式寄存器 */
+#define POWER_MODE              (0xCF)
+
 /* SPI Configuration */
 #define SPI_CONFIG              (0x32)
 
@@ -94,7 +97,7 @@
 #define INTERRUPT_EN_1          (0x41)
 
 /* Interrupt Configuration */
-#define INTERRUPT CONFIG        (0x44)
+#define INTERRUPT_CONFIG        (0x44)
 
 /* Interrupt Count Limit */
 #define INTERRUPT_CONT_LIM      (0x45)
@@ -171,35 +174,41 @@ typedef enum {
     ACC_DIGITAL_FILTER_ENABLE = 1  // 启用
 } AccDigitalFilter;
 
-/* ACC_CONFIG_1 位字段选项 */
+/* ACC_CONFIG_1 位字段选项，注释为数据手册中的二进制编码 */
 typedef enum {
-    ACC_ODR_1000HZ = 0x0000,
-    ACC_ODR_500HZ  = 0x0001,
-    ACC_ODR_250HZ  = 0x0010,
-    ACC_ODR_125HZ  = 0x0100,
-    ACC_ODR_63HZ   = 0x0101,
-    ACC_ODR_31HZ   = 0x0110,
-    ACC_ODR_16HZ   = 0x1000,
-    ACC_ODR_2000HZ = 0x1100,
-    ACC_ODR_4000HZ = 0x1101,
-    ACC_ODR_8000HZ = 0x1110
+    ACC_ODR_1000HZ = 0x00, // 0000
+    ACC_ODR_500HZ  = 0x01, // 0001
+    ACC_ODR_250HZ  = 0x02, // 0010
+    ACC_ODR_125HZ  = 0x04, // 0100
+    ACC_ODR_63HZ   = 0x05, // 0101
+    ACC_ODR_31HZ   = 0x06, // 0110
+    ACC_ODR_16HZ   = 0x08, // 1000
+    ACC_ODR_2000HZ = 0x0C, // 1100
+    ACC_ODR_4000HZ = 0x0D, // 1101
+    ACC_ODR_8000HZ = 0x0E  // 1110
 } AccODR;
 
+/* 各配置寄存器中由驱动设置的位，修改配置时只更新这些位 */
+#define ACC_CONFIG_0_MASK       (0xC1)      // [7] workMode, [6] dither, [0] digitalFilter
+#define ACC_CONFIG_1_MASK       (0x0F)      // [3:0] odr
+#define ACC_CONFIG_2_MASK       (0x07)      // [2:0] range
+#define ACC_CONFIG_3_MASK       (0xE8)      // [7:5] lpfCutoff, [3] bypassLPF
+
 /* ACC_CONFIG_2 位字段选项 */
 typedef enum {
-    ACC_RANGE_16G  = 0x010,
-    ACC_RANGE_8G   = 0x011,
-    ACC_RANGE_4G   = 0x100,
-    ACC_RANGE_2G   = 0x101
+    ACC_RANGE_16G  = 0x02, // 010
+    ACC_RANGE_8G   = 0x03, // 011
+    ACC_RANGE_4G   = 0x04, // 100
+    ACC_RANGE_2G   = 0x05  // 101
 } AccRange;
 
 /* ACC_CONFIG_3 位字段选项 */
 typedef enum {
-    ACC_LPF_CUTOFF_0_40  = 0x000, // ODR × 0.40
-    ACC_LPF_CUTOFF_0_25  = 0x001, // ODR × 0.25
-    ACC_LPF_CUTOFF_0_11  = 0x010, // ODR × 0.11
-    ACC_LPF_CUTOFF_0_04  = 0x011, // ODR × 0.04
-    ACC_LPF_CUTOFF_0_02  = 0x100  // ODR × 0.02
+    ACC_LPF_CUTOFF_0_40  = 0x00, // 000, ODR × 0.40
+    ACC_LPF_CUTOFF_0_25  = 0x01, // 001, ODR × 0.25
+    ACC_LPF_CUTOFF_0_11  = 0x02, // 010, ODR × 0.11
+    ACC_LPF_CUTOFF_0_04  = 0x03, // 011, ODR × 0.04
+    ACC_LPF_CUTOFF_0_02  = 0x04  // 100, ODR × 0.02
 } AccLPFCutoff;
 
 typedef enum {
@@ -232,19 +241,19 @@ typedef enum {
     GYRO_DIGITAL_FILTER_ENABLE = 1    // 启用
 } GyroDigitalFilter;
 
-/* GYRO_CONFIG_1 位字段选项 */
+/* GYRO_CONFIG_1 位字段选项，注释为数据手册中的二进制编码 */
 typedef enum {
-    GYRO_ODR_1000HZ  = 0x0000,
-    GYRO_ODR_500HZ   = 0x0001,
-    GYRO_ODR_250HZ   = 0x0010,
-    GYRO_ODR_125HZ   = 0x0011,
-    GYRO_ODR_63HZ    = 0x0100,
-    GYRO_ODR_31HZ    = 0x0101,
-    GYRO_ODR_2KHZ    = 0x1000,
-    GYRO_ODR_4KHZ    = 0x1001,
-    GYRO_ODR_8KHZ    = 0x1010,
-    GYRO_ODR_16KHZ   = 0x1011,
-    GYRO_ODR_32KHZ   = 0x1100
+    GYRO_ODR_1000HZ  = 0x00, // 0000
+    GYRO_ODR_500HZ   = 0x01, // 0001
+    GYRO_ODR_250HZ   = 0x02, // 0010
+    GYRO_ODR_125HZ   = 0x03, // 0011
+    GYRO_ODR_63HZ    = 0x04, // 0100
+    GYRO_ODR_31HZ    = 0x05, // 0101
+    GYRO_ODR_2KHZ    = 0x08, // 1000
+    GYRO_ODR_4KHZ    = 0x09, // 1001
+    GYRO_ODR_8KHZ    = 0x0A, // 1010
+    GYRO_ODR_16KHZ   = 0x0B, // 1011
+    GYRO_ODR_32KHZ   = 0x0C  // 1100
 } GyroODR;
 
 /* GYRO_CONFIG_2 位字段选项 */
@@ -262,13 +271,22 @@ typedef enum {
 
 /* GYRO_CONFIG_3, GYRO_CONFIG_4, GYRO_CONFIG_5 位字段选项 */
 typedef enum {
-    GYRO_FSR_125DPS  = 0x010,  // 125dps
-    GYRO_FSR_250DPS  = 0x011,  // 250dps
-    GYRO_FSR_500DPS  = 0x100,  // 500dps
-    GYRO_FSR_1000DPS = 0x101,  // 1000dps
-    GYRO_FSR_2000DPS = 0x110   // 2000dps
+    GYRO_FSR_125DPS  = 0x02,  // 010, 125dps
+    GYRO_FSR_250DPS  = 0x03,  // 011, 250dps
+    GYRO_FSR_500DPS  = 0x04,  // 100, 500dps
+    GYRO_FSR_1000DPS = 0x05,  // 101, 1000dps
+    GYRO_FSR_2000DPS = 0x06   // 110, 2000dps
 } GyroFSR;
 
+#define GYRO_CONFIG_0_MASK      (0x11)      // [4] shutDown, [0] digitalFilter
+#define GYRO_CONFIG_1_MASK      (0x0F)      // [3:0] odr
+#define GYRO_CONFIG_2_MASK      (0x1C)      // [4] lpfBypass, [3:2] lpfCutoff
+#define GYRO_FSR_MASK           (0x07)      // GYRO_CONFIG_3/4/5 [2:0]
+
+#define POWER_MODE_MASK         (0x07)      // POWER_MODE [2:0]
+#define POWER_MODE_NORMAL       (0x00)      // 加速度计和陀螺仪正常工作
+#define POWER_MODE_GYRO_DOWN    (0x06)      // 加速度计正常工作，陀螺仪掉电
+
 /* 陀螺仪配置结构体 */
 typedef struct {
     GyroShutDown shutDown;         // GYRO_CONFIG_0 [4]
@@ -302,6 +320,10 @@ typedef enum {
     TEMP_SENSOR_ANALOG_ENABLE = 1    // 禁用 温度传感器（模拟）
 } TempSensorAnalog;
 
+/* TEMP_SENSOR_CONFIG0 [3:0] 为出厂写入的室温值高 4 位，配置时不能改动 */
+#define TEMP_SENSOR_CONFIG_0_MASK   (0xB0)  // [7] digitalEnable, [5:4] odr
+#define TEMP_SENSOR_CONFIG_2_MASK   (0x04)  // [2] analogEnable
+
 // 温度传感器配置结构体
 typedef struct {
     TempSensorDigital digitalEnable; // TEMP_SENSOR_CONFIG0 [7]
@@ -309,4 +331,224 @@ typedef struct {
     TempSensorAnalog analogEnable;   // TEMP_SENSOR_CONFIG2 [2]
 } TempSensorConfig;
 
-#endif
\ No newline at end of file
+/***************************** FIFO Configuration ****************************/
+
+/* FIFO_CONFIG_0 位字段选项 */
+#define FIFO_RESET              (1 << 7)    // 写 1 清空 FIFO
+#define FIFO_MODE_MASK          (0x03)
+
+typedef enum {
+    FIFO_MODE_BYPASS = 0x00, // 不使用 FIFO
+    FIFO_MODE_FIFO   = 0x01, // FIFO 满后停止写入
+    FIFO_MODE_STREAM = 0x02  // FIFO 满后覆盖最旧的数据
+} FifoMode;
+
+/* FIFO_CONFIG_1 为水位线低 8 位，FIFO_CONFIG_2 [2:0] 为水位线高 3 位，单位：字（2 字节） */
+#define FIFO_WATERMARK_H_MASK   (0x07)
+
+/* FIFO_CONFIG_3 通道使能，每个使能的通道在一帧中占一个字，按下面的位序排列 */
+#define FIFO_CHANNEL_ACC_X      (1 << 0)
+#define FIFO_CHANNEL_ACC_Y      (1 << 1)
+#define FIFO_CHANNEL_ACC_Z      (1 << 2)
+#define FIFO_CHANNEL_GYRO_X     (1 << 3)
+#define FIFO_CHANNEL_GYRO_Y     (1 << 4)
+#define FIFO_CHANNEL_GYRO_Z     (1 << 5)
+#define FIFO_CHANNEL_TEMP       (1 << 6)
+#define FIFO_CHANNEL_ACC        (FIFO_CHANNEL_ACC_X | FIFO_CHANNEL_ACC_Y | FIFO_CHANNEL_ACC_Z)
+#define FIFO_CHANNEL_GYRO       (FIFO_CHANNEL_GYRO_X | FIFO_CHANNEL_GYRO_Y | FIFO_CHANNEL_GYRO_Z)
+
+/* FIFO_STATUS_0 为 FIFO 中数据量低 8 位，FIFO_STATUS_1 [2:0] 为高 3 位，单位：字 */
+#define FIFO_COUNT_H_MASK       (0x07)
+
+#define FIFO_DEPTH_WORDS        (1024)      // FIFO 深度，单位：字
+
+// FIFO 配置结构体
+typedef struct {
+    FifoMode mode;                  // FIFO_CONFIG_0 [1:0]
+    uint16_t watermark;             // FIFO_CONFIG_1 [7:0], FIFO_CONFIG_2 [2:0]
+    uint8_t channels;               // FIFO_CONFIG_3 [6:0]
+} FifoConfig;
+
+/************************** Interrupt Configuration ***************************/
+
+/* INTERRUPT_EN_0, INT_PINMP_0, INTERRUPT_STATUS_0 位定义 */
+#define INT0_ORIENT             (1 << 0)
+#define INT0_FLAT               (1 << 1)
+#define INT0_SINGLE_TAP         (1 << 2)
+#define INT0_DOUBLE_TAP         (1 << 3)
+#define INT0_ACT                (1 << 4)
+#define INT0_INACT              (1 << 5)
+#define INT0_HIGH_G             (1 << 6)
+#define INT0_LOW_G              (1 << 7)
+
+/* INTERRUPT_EN_1, INT_PINMP_1, INTERRUPT_STATUS_1 位定义 */
+#define INT1_FREE_FALL          (1 << 0)
+#define INT1_ACC_DRDY           (1 << 1)
+#define INT1_GYRO_DRDY          (1 << 3)
+#define INT1_FIFO_WATERMARK     (1 << 4)
+
+/* INT_PINMP_0/1：对应位为 0 时中断输出到 INT 引脚，为 1 时输出到 INT1 引脚 */
+
+/* INTERRUPT_CONFIG 位定义 */
+#define INT_CONFIG_LEVEL_LOW    (1 << 7)    // 0: 高电平有效，1: 低电平有效
+#define INT_CONFIG_LATCH        (1 << 6)    // 0: 不锁存，1: 锁存直到读取 INTERRUPT_STATUS
+
+/* INTERRUPT_CONT_LIM：不锁存时中断输出保持的时间 */
+#define INT_CONT_LIM_DEFAULT    (0x01)
+
+/********************** Activity / Inactivity Configuration *******************/
+
+/* ACT_INACT_CONFIG_0 位定义：AC 模式与进入检测时的加速度比较，DC 模式与 0（静止时与 1g）比较 */
+#define ACT_AC_MODE             (1 << 7)
+#define ACT_XYZ_EN              (0x70)      // [6:4] 活动检测使能 X/Y/Z 轴
+#define INACT_AC_MODE           (1 << 3)
+#define INACT_XYZ_EN            (0x07)      // [2:0] 无活动检测使能 X/Y/Z 轴
+
+/* 运动门控的默认值，均为寄存器原始值，可在设备树中用 motion_* 属性修改。
+ * ACT_INT_TIME 以加速度计采样为单位，INACT_INT_TIME 以秒为单位 */
+#define JASON_SH3001_ACT_THR        (32)
+#define JASON_SH3001_ACT_TIME       (1)
+#define JASON_SH3001_INACT_THR      (0x000200)
+#define JASON_SH3001_INACT_TIME     (10)
+#define JASON_SH3001_IDLE_ODR_HZ    (16)    // 静止时加速度计的 ODR
+
+/*********************** Event Detector Configuration ************************/
+
+/* TAP_ACT_INACT_CONFIG [3:1]：敲击检测使能 X/Y/Z 轴，其余位属于活动检测，配置时不能改动 */
+#define TAP_XYZ_EN              (0x0E)
+/* H_L_G_INT_CONFIG_0 [7:4]：高 g 检测使能（全部轴的总开关和 X/Y/Z 轴） */
+#define HIGH_G_XYZ_EN           (0xF0)
+
+/* 事件检测的默认值，均为寄存器原始值，可在设备树中用 event_* 属性修改 */
+#define JASON_SH3001_TAP_THR        (0x30)
+#define JASON_SH3001_TAP_DUR        (0x08)
+#define JASON_SH3001_TAP_LAT        (0x04)
+#define JASON_SH3001_DOUBLETAP_WIN  (0x10)
+#define JASON_SH3001_HIGH_G_THR     (0xC0)
+#define JASON_SH3001_HIGH_G_TIME    (0x04)
+#define JASON_SH3001_FREE_FALL_THR  (0x10)
+#define JASON_SH3001_FREE_FALL_TIME (0x08)
+
+/* 芯片能检测的事件 */
+#define JASON_SH3001_EVENTS     (SENSOR_EVENT_SINGLE_TAP | SENSOR_EVENT_DOUBLE_TAP | \
+                                 SENSOR_EVENT_FREE_FALL | SENSOR_EVENT_HIGH_G | \
+                                 SENSOR_EVENT_ORIENT | SENSOR_EVENT_FLAT)
+
+// 事件检测配置结构体
+typedef struct {
+    uint8_t tapThr;                 // TAP_INT_THR
+    uint8_t tapDur;                 // TAP_INT_DUR
+    uint8_t tapLat;                 // TAP_INT_LAT
+    uint8_t doubleTapWin;           // DOUBLETAP_INT_WIN
+    uint8_t highGThr;               // HIGH_G_INT_THR
+    uint8_t highGTime;              // HIGH_G_INT_TIME
+    uint8_t freeFallThr;            // FREE_FALL_INT_THR
+    uint8_t freeFallTime;           // FREE_FALL_INT_TIME
+} EventConfig;
+
+// 运动门控配置结构体
+typedef struct {
+    uint8_t actThr;                 // ACT_INT_THR
+    uint8_t actTime;                // ACT_INT_TIME
+    uint32_t inactThr;              // INACT_INT_THR_L/M/H，24 位
+    uint8_t inactTime;              // INACT_INT_TIME
+} MotionConfig;
+
+/********************************* Core ***************************************/
+
+/* ACC_XDATA_L ~ TEMP_DATA_H 地址连续，一次读取 14 字节即可得到同一时刻的全部数据，
+ * FIFO 同时缓存加速度计、陀螺仪和温度时，每帧的布局与此相同 */
+#define JASON_SH3001_FRAME_SIZE     (14)
+#define JASON_SH3001_ACC_OFFSET     (ACC_XDATA_L - ACC_XDATA_L)
+#define JASON_SH3001_GYRO_OFFSET    (GYRO_XDATA_L - ACC_XDATA_L)
+#define JASON_SH3001_TEMP_OFFSET    (TEMP_DATA_L - ACC_XDATA_L)
+
+/* 数据就绪中断模式下连同 INTERRUPT_STATUS_0/1 一起读取，读状态寄存器同时清除锁存的中断 */
+#define JASON_SH3001_BURST_SIZE     (INTERRUPT_STATUS_1 - ACC_XDATA_L + 1)
+#define JASON_SH3001_STATUS0_OFFSET (INTERRUPT_STATUS_0 - ACC_XDATA_L)
+#define JASON_SH3001_STATUS1_OFFSET (INTERRUPT_STATUS_1 - ACC_XDATA_L)
+
+#define JASON_SH3001_CHIP_ID        (0x61)
+#define JASON_SH3001_DEFAULT_ODR_HZ (500)
+
+struct iio_dev;
+struct regmap;
+
+/* 姿态融合状态，在主设备的 sensor_mutex 中读写 */
+struct jason_sh3001_fusion {
+    int q[4];                   // 四元数 w x y z，Q30
+    ktime_t last;               // 上一帧的采集时刻
+    bool init;                  // 下一帧用加速度计重新初始化姿态
+};
+
+/* 芯片共用数据，由核心在主设备（加速度计）初始化时分配，保存在主设备的 sensor->private_data 中 */
+struct jason_sh3001_data {
+    struct regmap *regmap;      // 寄存器访问，配置寄存器带缓存
+    FifoConfig fifo;            // fifo.mode 为 FIFO_MODE_BYPASS 时按帧轮询数据寄存器
+    int frame_size;             // 一帧的字节数
+    s64 period_ns;              // 当前 ODR 对应的采样周期
+    uint8_t *fifo_buf;          // 一次读空 FIFO 用的缓冲区
+    bool drdy;                  // 不使用 FIFO 且使能中断时，使用数据就绪中断采集
+    int room_temp;              // 25°C 对应的温度原始值，出厂时写在 TEMP_SENSOR_CONFIG_0/1 中
+    int acc_scale_nano;         // 当前量程下加速度计 1 LSB 对应的 n m/s^2
+    int acc_hz;                 // 加速度计请求的上报频率
+    int gyro_hz;                // 陀螺仪请求的上报频率
+    int angle_hz;               // 角度传感器请求的上报频率，0 表示未打开
+    int iio_hz;                 // IIO 缓冲区请求的频率，0 表示缓冲区未使能
+    struct jason_sh3001_fusion fusion;  // 角度传感器的姿态融合状态
+    bool suspended;             // runtime 挂起中，此时只记录请求的频率，恢复时再写入芯片
+    bool motion_gate;           // 使能运动门控：静止时关闭陀螺仪、加速度计降到低 ODR，需要中断
+    bool idle;                  // 运动门控：芯片报告了无活动，还没有报告活动
+    MotionConfig motion;        // 运动门控的阈值和时间
+    unsigned int events;        // 使能的 SENSOR_EVENT_* 事件
+    bool streaming;             // 有功能在采集数据，数据中断（FIFO 水位或数据就绪）已使能
+    EventConfig event;          // 事件检测的阈值和时间
+    s64 fifo_latency_ns;        // 水位线对应的时间，ODR 改变时按它重新计算水位线
+    int gyro_scale_nano;        // 当前量程下陀螺仪 1 LSB 对应的 n rad/s
+    struct sensor_private_data *acc;    // 主设备
+    struct sensor_private_data *gyro;   // 从设备
+    struct sensor_private_data *temp;   // 从设备
+    struct sensor_private_data *angle;  // 从设备，由加速度计和陀螺仪融合得到
+    struct iio_dev *indio_dev;          // IIO 设备，未注册时为 NULL
+};
+
+// 温度原始值为 12 位，每 16 LSB 为 1°C，室温值对应 25°C，换算为 0.001°C
+static inline int jason_sh3001_temp_mdeg(const struct jason_sh3001_data *data, const uint8_t *buf)
+{
+    int raw = ((buf[1] & 0x0F) << 8) | buf[0];
+
+    return (raw - data->room_temp) * 1000 / 16 + 25000;
+}
+
+/* jason_sh3001_core.c */
+extern int jason_sh3001_read_reg(struct i2c_client *client, uint8_t addr, uint8_t *buf);
+extern int jason_sh3001_write_reg(struct i2c_client *client, uint8_t addr, uint8_t data);
+extern int jason_sh3001_read_regs(struct i2c_client *client, uint8_t addr, int len, uint8_t *buf);
+extern int jason_sh3001_update_bits(struct i2c_client *client, uint8_t addr, uint8_t mask, uint8_t data);
+extern int jason_sh3001_core_init(struct i2c_client *client);
+extern int jason_sh3001_core_active(struct i2c_client *client, int enable, int rate);
+extern int jason_sh3001_core_report(struct i2c_client *client);
+extern int jason_sh3001_core_set_iio_rate(struct i2c_client *client, int hz);
+extern int jason_sh3001_core_set_fifo_frames(struct i2c_client *client, int frames);
+extern int jason_sh3001_core_set_rate(struct sensor_private_data *sensor, int period_us);
+extern int jason_sh3001_core_suspend(struct i2c_client *client);
+extern int jason_sh3001_core_set_events(struct sensor_private_data *sensor, unsigned int events);
+extern int jason_sh3001_core_resume(struct i2c_client *client);
+extern int jason_sh3001_core_angle_active(struct i2c_client *client, int enable, int rate);
+
+/* jason_sh3001_acc.c, jason_sh3001_gyro.c, jason_sh3001_temp.c, jason_sh3001_angle.c */
+extern struct sensor_operate jason_sh3001_acc_ops;
+extern struct sensor_operate jason_sh3001_gyro_ops;
+extern struct sensor_operate jason_sh3001_temp_ops;
+extern struct sensor_operate jason_sh3001_angle_ops;
+extern void jason_sh3001_acc_report(struct sensor_private_data *sensor, const uint8_t *buf, ktime_t timestamp);
+extern void jason_sh3001_gyro_report(struct sensor_private_data *sensor, const uint8_t *buf, ktime_t timestamp);
+extern void jason_sh3001_temp_report(struct sensor_private_data *sensor, const uint8_t *buf, ktime_t timestamp);
+extern void jason_sh3001_angle_update(struct jason_sh3001_data *data, const uint8_t *frame, ktime_t timestamp);
+
+/* jason_sh3001_iio.c */
+extern int jason_sh3001_iio_init(struct i2c_client *client);
+extern void jason_sh3001_iio_remove(struct i2c_client *client);
+extern void jason_sh3001_iio_push(struct jason_sh3001_data *data, const uint8_t *frame, ktime_t timestamp);
+
+#endif
@@ -0,0 +1,275 @@
+#include <linux/kernel.h>
+#include <linux/i2c.h>
+#include <linux/input.h>
+#include <linux/types.h>
+#include <linux/interrupt.h>
+#include <linux/math64.h>
+#include "jason_sh3001.h"
+
+/**********************************Specific**************************************/
+
+/*
+ * 姿态融合：Mahony 互补滤波，四元数为 Q30 定点，每帧加速度计和陀螺仪数据更新一次。
+ * 陀螺仪积分得到姿态，加速度计测得的重力方向与由姿态推算的重力方向的叉积作为误差，
+ * 按比例增益修正角速度。没有磁力计，航向角只由陀螺仪积分得到，会缓慢漂移。
+ */
+
+#define FUSION_ONE              (1LL << 30)
+#define FUSION_KP               (1 << 15)       // 比例增益 0.5，Q16
+#define FUSION_DT_MAX_NS        (50000000LL)    // 两帧间隔超过 50ms 时按 50ms 积分，避免溢出
+
+/* atan(2^-i)，单位 1e-6 度，CORDIC 使用 */
+static const int jason_sh3001_atan_table[] = {
+    45000000, 26565051, 14036243, 7125016, 3576334, 1789911, 895174, 447614,
+    223811, 111906, 55953, 27976, 13988, 6994, 3497, 1749,
+    874, 437, 219, 109,
+};
+
+static u64 jason_sh3001_sqrt64(u64 x)
+{
+    u64 r = 0, bit = 1ULL << 62;
+
+    while (bit > x)
+        bit >>= 2;
+
+    while (bit) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return r;
+}
+
+// CORDIC 求 atan2(y, x)，单位 0.001 度，范围 [-180000, 180000]
+static int jason_sh3001_atan2(s64 y, s64 x)
+{
+    s64 angle = 0, xn;
+    int i;
+
+    if (x == 0 && y == 0)
+        return 0;
+
+    /* 放大到 Q30 量级，移位迭代才有足够的精度 */
+    while (abs(x) < FUSION_ONE && abs(y) < FUSION_ONE) {
+        x <<= 1;
+        y <<= 1;
+    }
+
+    /* 旋转到右半平面：atan2(y, x) = atan2(-y, -x) ± 180° */
+    if (x < 0) {
+        angle = y >= 0 ? 180000000 : -180000000;
+        x = -x;
+        y = -y;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(jason_sh3001_atan_table); i++) {
+        if (y > 0) {
+            xn = x + (y >> i);
+            y -= x >> i;
+            angle += jason_sh3001_atan_table[i];
+        } else {
+            xn = x - (y >> i);
+            y += x >> i;
+            angle -= jason_sh3001_atan_table[i];
+        }
+        x = xn;
+    }
+
+    return (int)div_s64(angle, 1000);
+}
+
+// 四元数转换为欧拉角（横滚、俯仰、航向，ZYX 顺序），单位 0.001 度
+static void jason_sh3001_euler(const int *q, struct sensor_axis *axis)
+{
+    s64 q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    s64 s;
+
+    axis->x = jason_sh3001_atan2((q0 * q1 + q2 * q3) >> 29,
+        FUSION_ONE - ((q1 * q1 + q2 * q2) >> 29));
+
+    /* asin(s) = atan2(s, sqrt(1 - s^2))，数值误差可能让 |s| 略大于 1 */
+    s = clamp_t(s64, (q0 * q2 - q3 * q1) >> 29, -FUSION_ONE, FUSION_ONE);
+    axis->y = jason_sh3001_atan2(s, jason_sh3001_sqrt64(FUSION_ONE * FUSION_ONE - s * s));
+
+    axis->z = jason_sh3001_atan2((q0 * q3 + q1 * q2) >> 29,
+        FUSION_ONE - ((q2 * q2 + q3 * q3) >> 29));
+}
+
+static void jason_sh3001_quat_normalize(int *q, s64 q0, s64 q1, s64 q2, s64 q3)
+{
+    s64 n = jason_sh3001_sqrt64(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+
+    if (n == 0) {
+        q[0] = FUSION_ONE;
+        q[1] = q[2] = q[3] = 0;
+        return;
+    }
+
+    q[0] = div64_s64(q0 << 30, n);
+    q[1] = div64_s64(q1 << 30, n);
+    q[2] = div64_s64(q2 << 30, n);
+    q[3] = div64_s64(q3 << 30, n);
+}
+
+// 由 Q30 的 cos(θ) 求 cos(θ/2) 或 |sin(θ/2)|，sign 为 -1 时求后者
+static s64 jason_sh3001_half_angle(s64 c, int sign)
+{
+    return jason_sh3001_sqrt64(((FUSION_ONE + sign * c) / 2) << 30);
+}
+
+/*
+ * 第一帧用加速度计初始化：由重力方向求横滚和俯仰，航向为 0，q = qy(pitch) ⊗ qx(roll)。
+ * a 为 Q30 单位向量。
+ */
+static void jason_sh3001_fusion_init(struct jason_sh3001_fusion *f, const s64 *a)
+{
+    s64 n = jason_sh3001_sqrt64(a[1] * a[1] + a[2] * a[2]);
+    s64 cr = FUSION_ONE, sr = 0, cp, sp;
+
+    /* 竖直放置时横滚不确定，取 0 */
+    if (n > 0) {
+        cr = jason_sh3001_half_angle(div64_s64(a[2] << 30, n), 1);
+        sr = jason_sh3001_half_angle(div64_s64(a[2] << 30, n), -1);
+        if (a[1] < 0)
+            sr = -sr;
+    }
+    cp = jason_sh3001_half_angle(n, 1);
+    sp = jason_sh3001_half_angle(n, -1);
+    if (a[0] > 0)
+        sp = -sp;
+
+    jason_sh3001_quat_normalize(f->q, (cp * cr) >> 30, (cp * sr) >> 30,
+        (sp * cr) >> 30, -((sp * sr) >> 30));
+}
+
+/*
+ * acc 为任意单位的加速度，g 为 Q30 rad/s 的角速度，都在输出坐标系下，g 会被修正项改写。
+ * 调用者需持有主设备的 sensor_mutex。
+ */
+static void jason_sh3001_fusion_update(struct jason_sh3001_fusion *f,
+            const s64 *acc, s64 *g, s64 dt_ns)
+{
+    s64 q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+    s64 a[3], v[3], h[3];
+    s64 n;
+    int i;
+
+    n = jason_sh3001_sqrt64(acc[0] * acc[0] + acc[1] * acc[1] + acc[2] * acc[2]);
+    if (n > 0) {
+        for (i = 0; i < 3; i++)
+            a[i] = div64_s64(acc[i] << 30, n);
+
+        if (f->init) {
+            jason_sh3001_fusion_init(f, a);
+            f->init = false;
+            return;
+        }
+
+        /* 由姿态推算的重力方向（机体坐标系），与测得的方向做叉积得到误差，修正角速度 */
+        v[0] = (q1 * q3 - q0 * q2) >> 29;
+        v[1] = (q0 * q1 + q2 * q3) >> 29;
+        v[2] = (q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3) >> 30;
+        g[0] += (((a[1] * v[2] - a[2] * v[1]) >> 30) * FUSION_KP) >> 16;
+        g[1] += (((a[2] * v[0] - a[0] * v[2]) >> 30) * FUSION_KP) >> 16;
+        g[2] += (((a[0] * v[1] - a[1] * v[0]) >> 30) * FUSION_KP) >> 16;
+    }
+
+    if (f->init)
+        return;
+
+    /* q += 0.5 * q ⊗ (0, g) * dt */
+    for (i = 0; i < 3; i++)
+        h[i] = div_s64(g[i] * dt_ns, 2 * NSEC_PER_SEC);
+
+    jason_sh3001_quat_normalize(f->q,
+        q0 + ((-q1 * h[0] - q2 * h[1] - q3 * h[2]) >> 30),
+        q1 + (( q0 * h[0] + q2 * h[2] - q3 * h[1]) >> 30),
+        q2 + (( q0 * h[1] - q1 * h[2] + q3 * h[0]) >> 30),
+        q3 + (( q0 * h[2] + q1 * h[1] - q2 * h[0]) >> 30));
+}
+
+/*
+ * 每帧都参与融合（不按上报周期降频），按角度传感器请求的周期上报欧拉角和四元数。
+ * 加速度计和陀螺仪使用各自的校准、温度补偿和坐标变换，在主设备的 sensor_mutex 中调用。
+ */
+void jason_sh3001_angle_update(struct jason_sh3001_data *data,
+            const uint8_t *frame, ktime_t timestamp)
+{
+    struct sensor_private_data *sensor = data->angle;
+    struct jason_sh3001_fusion *f = &data->fusion;
+    struct sensor_axis acc, gyro, euler;
+    s64 a[3], g[3];
+    s64 dt_ns;
+
+    if (!data->gyro)
+        return;
+
+    jason_sensor_convert(data->acc, frame + JASON_SH3001_ACC_OFFSET, &acc);
+    jason_sensor_convert(data->gyro, frame + JASON_SH3001_GYRO_OFFSET, &gyro);
+    a[0] = acc.x;
+    a[1] = acc.y;
+    a[2] = acc.z;
+    g[0] = gyro.x;
+    g[1] = gyro.y;
+    g[2] = gyro.z;
+
+    /* 陀螺仪上报原始值时按量程换算为 urad/s，再换算为 Q30 rad/s */
+    if (!(data->gyro->pdata->si_units && data->gyro->scale_nano)) {
+        g[0] = div_s64(g[0] * data->gyro_scale_nano, 1000);
+        g[1] = div_s64(g[1] * data->gyro_scale_nano, 1000);
+        g[2] = div_s64(g[2] * data->gyro_scale_nano, 1000);
+    }
+    g[0] = div_s64(g[0] << 30, 1000000);
+    g[1] = div_s64(g[1] << 30, 1000000);
+    g[2] = div_s64(g[2] << 30, 1000000);
+
+    dt_ns = f->init ? 0 : ktime_to_ns(ktime_sub(timestamp, f->last));
+    dt_ns = clamp_t(s64, dt_ns, 0, FUSION_DT_MAX_NS);
+    f->last = timestamp;
+
+    jason_sh3001_fusion_update(f, a, g, dt_ns);
+    if (f->init || !jason_sensor_sample_due(sensor, timestamp))
+        return;
+
+    jason_sh3001_euler(f->q, &euler);
+
+    /* Report angle sensor information */
+    input_report_abs(sensor->input_dev, ABS_X, euler.x);
+    input_report_abs(sensor->input_dev, ABS_Y, euler.y);
+    input_report_abs(sensor->input_dev, ABS_Z, euler.z);
+    jason_sensor_input_sync(sensor, timestamp);
+
+    jason_sensor_publish_quat(sensor, f->q, timestamp);
+    jason_sensor_publish(sensor, &euler, timestamp);
+}
+
+/**********************************General**************************************/
+
+/* 角度传感器是虚拟的从设备，由核心把每帧加速度计和陀螺仪数据交给 jason_sh3001_angle_update 融合 */
+struct sensor_operate jason_sh3001_angle_ops = {
+    .name = "jason_sh3001_angle",
+    .type = SENSOR_TYPE_ANGLE,
+    .id_i2c = ANGLE_ID_ALL,
+    .read_reg = ACC_XDATA_L,
+    .read_len = JASON_SH3001_FRAME_SIZE,
+    .id_reg = CHIP_ID,
+    .id_data = JASON_SH3001_CHIP_ID,
+    .precision = 16,
+    .ctrl_reg = -1,
+    .ctrl_data = -1,
+    .int_ctrl_reg = -1,
+    .int_status_reg = -1,
+    .range = {-180000, 180000},
+    .trig = IRQF_TRIGGER_HIGH | IRQF_ONESHOT,
+    .init = NULL,
+    .active = jason_sh3001_core_angle_active,
+    .report = NULL,
+    .suspend = NULL,
+    .resume = NULL,
+    .set_rate = jason_sh3001_core_set_rate,
+};
@@ -0,0 +1,1401 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/i2c.h>
+#include <linux/input.h>
+#include <linux/types.h>
+#include <linux/interrupt.h>
+#include <linux/slab.h>
+#include <linux/bitops.h>
+#include <linux/regmap.h>
+#include <linux/of.h>
+#include "jason_sh3001.h"
+#include "jason_sensor_trace.h"
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Jason Jia");
+MODULE_DESCRIPTION("A driver for sh3001 6-axis imu.");
+
+/*
+ * SH3001 核心：一个 i2c client 对应整颗芯片，负责芯片配置、FIFO 和中断，
+ * 每个采样周期用一次 i2c 传输读出加速度计、陀螺仪和温度的数据，再分发给各自的 sensor。
+ * 加速度计是主设备，陀螺仪和温度传感器作为从设备共用主设备的采集。
+ */
+
+/* ODR 与采样周期对照表，加速度计和陀螺仪使用相同的 ODR，按频率从低到高排列。
+ * 陀螺仪最低为 31Hz，16Hz 时陀螺仪按 31Hz 输出，读取时取最新值 */
+static const struct {
+    int hz;
+    AccODR acc_odr;
+    GyroODR gyro_odr;
+    s64 period_ns;
+} jason_sh3001_odr_table[] = {
+    {   16, ACC_ODR_16HZ,   GYRO_ODR_31HZ,   64000000 },
+    {   31, ACC_ODR_31HZ,   GYRO_ODR_31HZ,   32000000 },
+    {   63, ACC_ODR_63HZ,   GYRO_ODR_63HZ,   16000000 },
+    {  125, ACC_ODR_125HZ,  GYRO_ODR_125HZ,   8000000 },
+    {  250, ACC_ODR_250HZ,  GYRO_ODR_250HZ,   4000000 },
+    {  500, ACC_ODR_500HZ,  GYRO_ODR_500HZ,   2000000 },
+    { 1000, ACC_ODR_1000HZ, GYRO_ODR_1000HZ,  1000000 },
+    { 2000, ACC_ODR_2000HZ, GYRO_ODR_2KHZ,     500000 },
+    { 4000, ACC_ODR_4000HZ, GYRO_ODR_4KHZ,     250000 },
+    { 8000, ACC_ODR_8000HZ, GYRO_ODR_8KHZ,     125000 },
+};
+
+/* 各量程下 1 LSB 对应的 SI 单位大小：加速度计为 n m/s^2（g = 9.80665），陀螺仪为 n rad/s */
+static int jason_sh3001_acc_scale_nano(AccRange range)
+{
+    switch (range) {
+    case ACC_RANGE_16G:
+        return 4788403;
+    case ACC_RANGE_8G:
+        return 2394202;
+    case ACC_RANGE_4G:
+        return 1197101;
+    default:
+        return 598550;
+    }
+}
+
+static int jason_sh3001_gyro_scale_nano(GyroFSR fsr)
+{
+    switch (fsr) {
+    case GYRO_FSR_125DPS:
+        return 66579;
+    case GYRO_FSR_250DPS:
+        return 133158;
+    case GYRO_FSR_500DPS:
+        return 266316;
+    case GYRO_FSR_1000DPS:
+        return 532632;
+    default:
+        return 1065264;
+    }
+}
+
+/**********************************Specific**************************************/
+
+// 选择不低于 hz 的最小 ODR，超出范围时取最高 ODR，返回对照表下标
+static int jason_sh3001_odr_index(int hz)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(jason_sh3001_odr_table); i++) {
+        if (jason_sh3001_odr_table[i].hz >= hz)
+            return i;
+    }
+
+    return ARRAY_SIZE(jason_sh3001_odr_table) - 1;
+}
+
+// 配置 FIFO 寄存器，同时清空 FIFO 中已有的数据
+static int configureFifo(struct i2c_client *client, const FifoConfig *config)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+
+    if(jason_sh3001_update_bits(client, FIFO_CONFIG_3, 0x7F, config->channels) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_update_bits(client, FIFO_CONFIG_1, 0xFF, config->watermark & 0xFF) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_update_bits(client, FIFO_CONFIG_2, FIFO_WATERMARK_H_MASK,
+            (config->watermark >> 8) & FIFO_WATERMARK_H_MASK) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    // 最后写工作模式，FIFO 从此开始缓存数据。FIFO_RESET 每次都要写入，不能因为缓存中的值相同而跳过
+    if(regmap_write_bits(data->regmap, FIFO_CONFIG_0, FIFO_RESET | FIFO_MODE_MASK,
+            FIFO_RESET | (config->mode & FIFO_MODE_MASK)) < 0)
+        return JASON_SH3001_FALSE;
+
+    return JASON_SH3001_TRUE;
+}
+
+// 配置中断：高电平有效，config 中可选择是否锁存，全部映射到 INT 引脚，并使能 en0/en1 中的中断源
+static int configureInterrupt(struct i2c_client *client, uint8_t config, uint8_t en0, uint8_t en1)
+{
+    if(jason_sh3001_write_reg(client, INTERRUPT_CONFIG, config) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INTERRUPT_CONT_LIM, INT_CONT_LIM_DEFAULT) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INT_PINMP_0, 0) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INT_PINMP_1, 0) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INTERRUPT_EN_0, en0) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INTERRUPT_EN_1, en1) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    return JASON_SH3001_TRUE;
+}
+
+// 配置温度传感器寄存器，TEMP_SENSOR_CONFIG1 为室温值的低 8 位，不需要设置
+static int configureTempSensor(struct i2c_client *client, const TempSensorConfig *config) {
+    uint8_t reg0 = 0, reg2 = 0;
+
+    // 配置 TEMP_SENSOR_CONFIG0
+    reg0 |= (config->digitalEnable << 7);
+    reg0 |= (config->odr << 4);
+
+    // 配置 TEMP_SENSOR_CONFIG2
+    reg2 |= (config->analogEnable << 2);
+
+    if(jason_sh3001_update_bits(client, TEMP_SENSOR_CONFIG_0, TEMP_SENSOR_CONFIG_0_MASK, reg0) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_update_bits(client, TEMP_SENSOR_CONFIG_2, TEMP_SENSOR_CONFIG_2_MASK, reg2) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    return JASON_SH3001_TRUE;
+}
+
+// 配置活动和无活动检测：三个轴都参与，AC 模式，不受静止时重力方向的影响
+static int configureMotion(struct i2c_client *client, const MotionConfig *config)
+{
+    if(jason_sh3001_write_reg(client, ACT_INACT_CONFIG_0,
+            ACT_AC_MODE | ACT_XYZ_EN | INACT_AC_MODE | INACT_XYZ_EN) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, ACT_INT_THR, config->actThr) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, ACT_INT_TIME, config->actTime) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INACT_INT_THR_L, config->inactThr & 0xFF) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INACT_INT_THR_M, (config->inactThr >> 8) & 0xFF) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INACT_INT_THR_H, (config->inactThr >> 16) & 0xFF) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, INACT_INT_TIME, config->inactTime) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    return JASON_SH3001_TRUE;
+}
+
+// 配置敲击、高 g 和自由落体检测的阈值和时间，方向和水平检测使用芯片的默认配置
+static int configureEvents(struct i2c_client *client, const EventConfig *config)
+{
+    if(jason_sh3001_update_bits(client, TAP_ACT_INACT_CONFIG, TAP_XYZ_EN, TAP_XYZ_EN) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, TAP_INT_THR, config->tapThr) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, TAP_INT_DUR, config->tapDur) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, TAP_INT_LAT, config->tapLat) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, DOUBLETAP_INT_WIN, config->doubleTapWin) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_update_bits(client, H_L_G_INT_CONFIG_0, HIGH_G_XYZ_EN, HIGH_G_XYZ_EN) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, HIGH_G_INT_THR, config->highGThr) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, HIGH_G_INT_TIME, config->highGTime) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, FREE_FALL_INT_THR, config->freeFallThr) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_write_reg(client, FREE_FALL_INT_TIME, config->freeFallTime) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    return JASON_SH3001_TRUE;
+}
+
+/*
+ * 寄存器映射：数据、状态、FIFO 和 i2c 主机命令寄存器每次都从芯片读取，其余配置寄存器使用平坦缓存，
+ * 读配置不产生 i2c 传输，写配置时值没有变化就不写。
+ * 读中断状态会清除锁存的中断，读 FIFO_DATA 会取走数据，不能被调试接口读取。
+ */
+static const struct regmap_range jason_sh3001_volatile_ranges[] = {
+    regmap_reg_range(ACC_XDATA_L, FIFO_DATA),
+    regmap_reg_range(MI2C_COMM_0, MI2C_RAD_DATA),
+};
+
+static const struct regmap_access_table jason_sh3001_volatile_table = {
+    .yes_ranges = jason_sh3001_volatile_ranges,
+    .n_yes_ranges = ARRAY_SIZE(jason_sh3001_volatile_ranges),
+};
+
+static const struct regmap_range jason_sh3001_precious_ranges[] = {
+    regmap_reg_range(INTERRUPT_STATUS_0, INTERRUPT_STATUS_4),
+    regmap_reg_range(FIFO_DATA, FIFO_DATA),
+};
+
+static const struct regmap_access_table jason_sh3001_precious_table = {
+    .yes_ranges = jason_sh3001_precious_ranges,
+    .n_yes_ranges = ARRAY_SIZE(jason_sh3001_precious_ranges),
+};
+
+/* 需要缓存的配置寄存器，地址连续的放在一段，初始化时按段从芯片读入缓存 */
+static const struct regmap_range jason_sh3001_cached_ranges[] = {
+    regmap_reg_range(TEMP_SENSOR_CONFIG_0, MI2C_CONFIG_1),
+    regmap_reg_range(INTERRUPT_EN_0, SPI_CONFIG_1),
+    regmap_reg_range(GYRO_CONFIG_3, GYRO_CONFIG_3),
+    regmap_reg_range(GYRO_CONFIG_4, GYRO_CONFIG_4),
+    regmap_reg_range(GYRO_CONFIG_5, GYRO_CONFIG_5),
+    regmap_reg_range(POWER_MODE, POWER_MODE),
+    regmap_reg_range(TEMP_SENSOR_CONFIG_2, TEMP_SENSOR_CONFIG_2),
+    regmap_reg_range(AUX_I2C_CONFIG, AUX_I2C_CONFIG),
+};
+
+static const struct regmap_range jason_sh3001_writeable_ranges[] = {
+    regmap_reg_range(TEMP_SENSOR_CONFIG_0, MI2C_WRT_DATA),
+    regmap_reg_range(INTERRUPT_EN_0, SPI_CONFIG_1),
+    regmap_reg_range(GYRO_CONFIG_3, GYRO_CONFIG_3),
+    regmap_reg_range(GYRO_CONFIG_4, GYRO_CONFIG_4),
+    regmap_reg_range(GYRO_CONFIG_5, GYRO_CONFIG_5),
+    regmap_reg_range(POWER_MODE, POWER_MODE),
+    regmap_reg_range(TEMP_SENSOR_CONFIG_2, TEMP_SENSOR_CONFIG_2),
+    regmap_reg_range(AUX_I2C_CONFIG, AUX_I2C_CONFIG),
+};
+
+static const struct regmap_access_table jason_sh3001_writeable_table = {
+    .yes_ranges = jason_sh3001_writeable_ranges,
+    .n_yes_ranges = ARRAY_SIZE(jason_sh3001_writeable_ranges),
+};
+
+static const struct regmap_config jason_sh3001_regmap_config = {
+    .reg_bits = 8,
+    .val_bits = 8,
+    .max_register = AUX_I2C_CONFIG,
+    .volatile_table = &jason_sh3001_volatile_table,
+    .precious_table = &jason_sh3001_precious_table,
+    .wr_table = &jason_sh3001_writeable_table,
+    .cache_type = REGCACHE_FLAT,
+};
+
+/*
+ * 平坦缓存没有记录哪些寄存器已经缓存，未写过的寄存器会读到 0，
+ * 所以初始化时先绕过缓存从芯片读出配置寄存器，再写入缓存（只写缓存，不产生 i2c 传输）。
+ * TEMP_SENSOR_CONFIG_0/1 中的室温值也由此进入缓存。
+ */
+static int jason_sh3001_regmap_init(struct i2c_client *client, struct jason_sh3001_data *data)
+{
+    uint8_t buf[SPI_CONFIG_1 - INTERRUPT_EN_0 + 1];
+    const struct regmap_range *range;
+    int i, len, ret = 0;
+
+    data->regmap = devm_regmap_init_i2c(client, &jason_sh3001_regmap_config);
+    if (IS_ERR(data->regmap)) {
+        dev_err(&client->dev, "init regmap failed: %ld\n", PTR_ERR(data->regmap));
+        return PTR_ERR(data->regmap);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(jason_sh3001_cached_ranges) && !ret; i++) {
+        range = &jason_sh3001_cached_ranges[i];
+        len = range->range_max - range->range_min + 1;
+
+        regcache_cache_bypass(data->regmap, true);
+        ret = regmap_bulk_read(data->regmap, range->range_min, buf, len);
+        regcache_cache_bypass(data->regmap, false);
+        if (ret)
+            break;
+
+        regcache_cache_only(data->regmap, true);
+        ret = regmap_bulk_write(data->regmap, range->range_min, buf, len);
+        regcache_cache_only(data->regmap, false);
+    }
+    if (ret)
+        dev_err(&client->dev, "fill register cache failed: %d\n", ret);
+
+    return ret;
+}
+
+static inline struct regmap *jason_sh3001_regmap(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+
+    return ((struct jason_sh3001_data *)sensor->private_data)->regmap;
+}
+
+// 写整个寄存器，值与缓存相同时不产生 i2c 传输
+int jason_sh3001_write_reg(struct i2c_client *client, uint8_t addr, uint8_t data)
+{
+    return jason_sh3001_update_bits(client, addr, 0xFF, data);
+}
+
+// 只修改 mask 中的位，值与缓存相同时不产生 i2c 传输
+int jason_sh3001_update_bits(struct i2c_client *client, uint8_t addr, uint8_t mask, uint8_t data)
+{
+    int ret;
+
+    ret = regmap_update_bits(jason_sh3001_regmap(client), addr, mask, data);
+    if (ret < 0) {
+        dev_err(&client->dev, "write reg 0x%02x failed: ret=%d\n", addr, ret);
+        return JASON_SH3001_FALSE;
+    }
+
+    return JASON_SH3001_TRUE;
+}
+
+int jason_sh3001_read_reg(struct i2c_client *client, uint8_t addr, uint8_t *buf)
+{
+    unsigned int val;
+    int ret;
+
+    ret = regmap_read(jason_sh3001_regmap(client), addr, &val);
+    if (ret < 0) {
+        dev_err(&client->dev, "read reg 0x%02x failed: ret=%d\n", addr, ret);
+        return JASON_SH3001_FALSE;
+    }
+    *buf = val;
+
+    return JASON_SH3001_TRUE;
+}
+
+// 读取地址连续的多个寄存器，数据寄存器一次 i2c 传输读出，配置寄存器从缓存读取
+int jason_sh3001_read_regs(struct i2c_client *client, uint8_t addr, int len, uint8_t *buf)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    /* 只有易失寄存器产生 i2c 传输，从缓存读取的不计入 i2c 计数，也不产生跟踪事件 */
+    bool xfer = regmap_reg_in_ranges(addr, jason_sh3001_volatile_ranges,
+        ARRAY_SIZE(jason_sh3001_volatile_ranges));
+    ktime_t start = 0;
+    int ret;
+
+    if (xfer) {
+        start = ktime_get();
+        trace_jason_sensor_i2c_start(sensor, addr, len);
+    }
+    ret = regmap_bulk_read(jason_sh3001_regmap(client), addr, buf, len);
+    if (xfer) {
+        trace_jason_sensor_i2c_end(sensor, addr, len, ret);
+        jason_sensor_stat_i2c(sensor, start, ret);
+    }
+    if (ret < 0) {
+        dev_err(&client->dev, "read regs 0x%02x failed: ret=%d\n", addr, ret);
+        return JASON_SH3001_FALSE;
+    }
+
+    return JASON_SH3001_TRUE;
+}
+
+/*
+ * 读 FIFO：FIFO_DATA 是单个地址，连续读时地址不递增。
+ * regmap 会把后面的字节当作 FIFO_DATA 之后的（带缓存的）寄存器，所以这里直接用 i2c 传输。
+ */
+static int jason_sh3001_read_fifo(struct i2c_client *client, int len, uint8_t *buf)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct i2c_msg msgs[2];
+    uint8_t addr = FIFO_DATA;
+    ktime_t start;
+    int ret;
+
+    msgs[0].flags = !I2C_M_RD;
+    msgs[0].addr = client->addr;
+    msgs[0].len = 1;
+    msgs[0].buf = &addr;
+
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].addr = client->addr;
+    msgs[1].len = len;
+    msgs[1].buf = buf;
+
+    start = ktime_get();
+    trace_jason_sensor_i2c_start(sensor, FIFO_DATA, len);
+    ret = i2c_transfer(client->adapter, msgs, 2);
+    trace_jason_sensor_i2c_end(sensor, FIFO_DATA, len, ret);
+    jason_sensor_stat_i2c(sensor, start, ret == 2 ? 0 : -EIO);
+    if (ret != 2) {
+        dev_err(&client->dev, "I2C transfer fifo failed: ret=%d\n", ret);
+        return JASON_SH3001_FALSE;
+    }
+
+    return JASON_SH3001_TRUE;
+}
+
+/* ACC_CONFIG_0 ~ GYRO_CONFIG_2（0x22 ~ 0x2B）地址连续，中间有未使用的地址，初始化时合并成一次 i2c 写 */
+#define JASON_SH3001_CFG_FIRST      ACC_CONFIG_0
+#define JASON_SH3001_CFG_LEN        (GYRO_CONFIG_2 - ACC_CONFIG_0 + 1)
+
+typedef struct {
+    uint8_t mask[JASON_SH3001_CFG_LEN];
+    uint8_t val[JASON_SH3001_CFG_LEN];
+} ConfigBlock;
+
+static void configBlockSet(ConfigBlock *block, uint8_t addr, uint8_t mask, uint8_t val)
+{
+    block->mask[addr - JASON_SH3001_CFG_FIRST] = mask;
+    block->val[addr - JASON_SH3001_CFG_FIRST] = val & mask;
+}
+
+// 在缓存中的值上合并出整段寄存器的新值，有变化时一次写入，未使用的地址写回原值
+static int configBlockWrite(struct i2c_client *client, const ConfigBlock *block)
+{
+    struct regmap *map = jason_sh3001_regmap(client);
+    uint8_t buf[JASON_SH3001_CFG_LEN], old;
+    bool changed = false;
+    int i;
+
+    if (regmap_bulk_read(map, JASON_SH3001_CFG_FIRST, buf, JASON_SH3001_CFG_LEN) < 0)
+        return JASON_SH3001_FALSE;
+
+    for (i = 0; i < JASON_SH3001_CFG_LEN; i++) {
+        old = buf[i];
+        buf[i] = (buf[i] & ~block->mask[i]) | block->val[i];
+        changed |= (buf[i] != old);
+    }
+    if (!changed)
+        return JASON_SH3001_TRUE;
+
+    if (regmap_bulk_write(map, JASON_SH3001_CFG_FIRST, buf, JASON_SH3001_CFG_LEN) < 0) {
+        dev_err(&client->dev, "write config block failed\n");
+        return JASON_SH3001_FALSE;
+    }
+
+    return JASON_SH3001_TRUE;
+}
+
+// GYRO_CONFIG_0 ~ GYRO_CONFIG_2 放入 block 中一起写，量程寄存器地址不连续，单独写入
+static int configureGyroscope(struct i2c_client *client, ConfigBlock *block, const GyroConfig *config)
+{
+    uint8_t reg0 = 0, reg1 = 0, reg2 = 0, reg3 = 0, reg4 = 0, reg5 = 0;
+
+    // 配置 GYRO_CONFIG_0
+    reg0 |= (config->shutDown << 4);
+    reg0 |= (config->digitalFilter << 0);
+
+    // 配置 GYRO_CONFIG_1
+    reg1 |= (config->odr & 0x0F);
+
+    // 配置 GYRO_CONFIG_2
+    reg2 |= (config->lpfBypass << 4);
+    reg2 |= (config->lpfCutoff << 2);
+
+    // 配置 GYRO_CONFIG_3, GYRO_CONFIG_4, GYRO_CONFIG_5
+    reg3 |= (config->fsrX & 0x07);
+    reg4 |= (config->fsrY & 0x07);
+    reg5 |= (config->fsrZ & 0x07);
+
+    configBlockSet(block, GYRO_CONFIG_0, GYRO_CONFIG_0_MASK, reg0);
+    configBlockSet(block, GYRO_CONFIG_1, GYRO_CONFIG_1_MASK, reg1);
+    configBlockSet(block, GYRO_CONFIG_2, GYRO_CONFIG_2_MASK, reg2);
+
+    if(jason_sh3001_update_bits(client, GYRO_CONFIG_3, GYRO_FSR_MASK, reg3) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_update_bits(client, GYRO_CONFIG_4, GYRO_FSR_MASK, reg4) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    if(jason_sh3001_update_bits(client, GYRO_CONFIG_5, GYRO_FSR_MASK, reg5) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    return JASON_SH3001_TRUE;
+}
+
+// ACC_CONFIG_0 ~ ACC_CONFIG_3 放入 block 中一起写
+static void configureAccelerometer(ConfigBlock *block, const AccConfig* config)
+{
+    uint8_t reg0 = 0, reg1 = 0, reg2 = 0, reg3 = 0;
+
+    // 配置 ACC_CONFIG_0
+    reg0 |= (config->workMode << 7);
+    reg0 |= (config->dither << 6);
+    reg0 |= (config->digitalFilter << 0);
+
+    // 配置 ACC_CONFIG_1
+    reg1 |= (config->odr & 0x0F);
+
+    // 配置 ACC_CONFIG_2
+    reg2 |= (config->range & 0x07);
+
+    // 配置 ACC_CONFIG_3
+    reg3 |= (config->lpfCutoff << 5);
+    reg3 |= (config->bypassLPF << 3);
+
+    configBlockSet(block, ACC_CONFIG_0, ACC_CONFIG_0_MASK, reg0);
+    configBlockSet(block, ACC_CONFIG_1, ACC_CONFIG_1_MASK, reg1);
+    configBlockSet(block, ACC_CONFIG_2, ACC_CONFIG_2_MASK, reg2);
+    configBlockSet(block, ACC_CONFIG_3, ACC_CONFIG_3_MASK, reg3);
+}
+
+static int jason_sh3001_sensor_init(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    ConfigBlock block = { {0}, {0} };
+    uint8_t room[2];
+    int index;
+    /* C90 变量声明必须在函数开头 */
+    AccConfig acc_config = {
+        .workMode = ACC_WORK_MODE_NORMAL,
+        .dither = ACC_DITHER_ENABLE,
+        .digitalFilter = ACC_DIGITAL_FILTER_ENABLE,
+        .odr = ACC_ODR_500HZ,
+        .range = ACC_RANGE_2G,
+        .lpfCutoff = ACC_LPF_CUTOFF_0_25,
+        .bypassLPF = ACC_BYPASS_LPF_NO
+    };
+
+    // 温度传感器配置
+    TempSensorConfig temp_sensor_config = {
+        .digitalEnable = TEMP_SENSOR_DIGITAL_ENABLE,
+        .odr = TEMP_SENSOR_ODR_63HZ,
+        .analogEnable = TEMP_SENSOR_ANALOG_DISABLE
+    };
+
+    // 初始化陀螺仪配置
+    GyroConfig gyro_config;
+
+    /* 运动门控时由芯片在无活动中断后自行关闭陀螺仪 */
+    gyro_config.shutDown = data->motion_gate ? GYRO_SHUT_DOWN_YES : GYRO_SHUT_DOWN_NO;
+    gyro_config.digitalFilter = GYRO_DIGITAL_FILTER_ENABLE;
+    gyro_config.odr = GYRO_ODR_500HZ;
+    gyro_config.lpfBypass = GYRO_LPF_BYPASS_DISABLE;
+    gyro_config.lpfCutoff = GYRO_LPF_CUTOFF_00;
+    gyro_config.fsrX = GYRO_FSR_2000DPS;
+    gyro_config.fsrY = GYRO_FSR_2000DPS;
+    gyro_config.fsrZ = GYRO_FSR_2000DPS;
+
+    index = jason_sh3001_odr_index(sensor->pdata->odr_hz);
+    acc_config.odr = jason_sh3001_odr_table[index].acc_odr;
+    gyro_config.odr = jason_sh3001_odr_table[index].gyro_odr;
+
+    /* 芯片 ID 已经由 sensor_get_id 按 ops->id_reg/id_data 检查过，这里不再重复读取 */
+
+    // 读取出厂校准的室温值，温度换算时使用（来自初始化时填充的寄存器缓存）
+    if(jason_sh3001_read_regs(client, TEMP_SENSOR_CONFIG_0, 2, room) == JASON_SH3001_FALSE){
+        dev_err(&client->dev, "Read room temperature error!\n");
+        return JASON_SH3001_FALSE;
+    }
+    data->room_temp = ((room[0] & 0x0F) << 8) | room[1];
+
+    configureAccelerometer(&block, &acc_config);
+    data->acc_scale_nano = jason_sh3001_acc_scale_nano(acc_config.range);
+    jason_sensor_set_scale(sensor, data->acc_scale_nano);
+
+    if(configureGyroscope(client, &block, &gyro_config) == JASON_SH3001_FALSE){
+        dev_err(&client->dev, "Configure gyroscope error!\n");
+        return JASON_SH3001_FALSE;
+    }
+    /* 三个轴使用相同的量程 */
+    data->gyro_scale_nano = jason_sh3001_gyro_scale_nano(gyro_config.fsrX);
+
+    /* 加速度计和陀螺仪的配置寄存器一次写入 */
+    if(configBlockWrite(client, &block) == JASON_SH3001_FALSE){
+        dev_err(&client->dev, "Configure accelerometer and gyroscope error!\n");
+        return JASON_SH3001_FALSE;
+    }
+
+    if(configureTempSensor(client, &temp_sensor_config) == JASON_SH3001_FALSE){
+        dev_err(&client->dev, "Configure temp_sensor error!\n");
+        return JASON_SH3001_FALSE;
+    }
+
+    if(data->motion_gate && configureMotion(client, &data->motion) == JASON_SH3001_FALSE){
+        dev_err(&client->dev, "Configure motion detection error!\n");
+        return JASON_SH3001_FALSE;
+    }
+
+    /* 检测器默认不产生中断，使能事件时才打开对应的中断 */
+    if(configureEvents(client, &data->event) == JASON_SH3001_FALSE){
+        dev_err(&client->dev, "Configure event detection error!\n");
+        return JASON_SH3001_FALSE;
+    }
+
+    return JASON_SH3001_TRUE;
+}
+
+/**********************************General**************************************/
+
+// 读取设备树中的 u8 配置，属性不存在时保持默认值
+static void jason_sh3001_read_u8_prop(struct i2c_client *client, const char *name, uint8_t *val)
+{
+    u32 tmp;
+
+    if (!of_property_read_u32(client->dev.of_node, name, &tmp))
+        *val = tmp;
+}
+
+int jason_sh3001_core_init(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor = 
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct sensor_platform_data *pdata = sensor->pdata;
+
+    struct jason_sh3001_data *data;
+    int ret = -1;
+    int index;
+    
+    dev_info(&client->dev, "irq enable: %d", pdata->irq_enable);
+
+    data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
+    if (!data)
+        return -ENOMEM;
+
+    if (pdata->odr_hz <= 0)
+        pdata->odr_hz = JASON_SH3001_DEFAULT_ODR_HZ;
+    index = jason_sh3001_odr_index(pdata->odr_hz);
+    pdata->odr_hz = jason_sh3001_odr_table[index].hz;
+    data->period_ns = jason_sh3001_odr_table[index].period_ns;
+    data->acc_hz = pdata->odr_hz;
+    data->gyro_hz = pdata->odr_hz;
+    data->frame_size = JASON_SH3001_FRAME_SIZE;
+    data->acc = sensor;
+
+    /* 使用 FIFO 时芯片按 ODR 缓存数据，每次中断或轮询用一次长读取读空 FIFO，
+     * 三种数据都进入 FIFO，每帧的布局与数据寄存器相同 */
+    if (pdata->fifo_watermark > 0) {
+        data->fifo.mode = FIFO_MODE_STREAM;
+        data->fifo.channels = FIFO_CHANNEL_ACC | FIFO_CHANNEL_GYRO | FIFO_CHANNEL_TEMP;
+        data->fifo.watermark = min(pdata->fifo_watermark,
+            FIFO_DEPTH_WORDS * 2 / data->frame_size) * data->frame_size / 2;
+        data->fifo_latency_ns = (s64)min(pdata->fifo_watermark,
+            FIFO_DEPTH_WORDS * 2 / data->frame_size) * data->period_ns;
+        data->fifo_buf = devm_kmalloc(&client->dev, FIFO_DEPTH_WORDS * 2, GFP_KERNEL);
+        if (!data->fifo_buf)
+            return -ENOMEM;
+        dev_info(&client->dev, "fifo mode, odr %dHz, watermark %d words\n",
+            pdata->odr_hz, data->fifo.watermark);
+    } else {
+        data->fifo.mode = FIFO_MODE_BYPASS;
+        /* 不使用 FIFO 时，每次加速度计数据就绪都产生中断，采样跟随芯片的 ODR 时钟 */
+        data->drdy = pdata->irq_enable;
+        if (data->drdy)
+            dev_info(&client->dev, "data ready irq mode, odr %dHz\n", pdata->odr_hz);
+    }
+    /* 运动门控依赖活动/无活动中断，轮询模式下不使用 */
+    data->motion_gate = of_property_read_bool(client->dev.of_node, "motion_gate");
+    if (data->motion_gate && !pdata->irq_enable) {
+        dev_warn(&client->dev, "motion gate needs irq, disabled\n");
+        data->motion_gate = false;
+    }
+    if (data->motion_gate) {
+        data->motion.actThr = JASON_SH3001_ACT_THR;
+        data->motion.actTime = JASON_SH3001_ACT_TIME;
+        data->motion.inactThr = JASON_SH3001_INACT_THR;
+        data->motion.inactTime = JASON_SH3001_INACT_TIME;
+        jason_sh3001_read_u8_prop(client, "motion_act_thr", &data->motion.actThr);
+        jason_sh3001_read_u8_prop(client, "motion_act_time", &data->motion.actTime);
+        of_property_read_u32(client->dev.of_node, "motion_inact_thr", &data->motion.inactThr);
+        jason_sh3001_read_u8_prop(client, "motion_inact_time", &data->motion.inactTime);
+        dev_info(&client->dev, "motion gate, idle after %ds\n", data->motion.inactTime);
+    }
+
+    data->event.tapThr = JASON_SH3001_TAP_THR;
+    data->event.tapDur = JASON_SH3001_TAP_DUR;
+    data->event.tapLat = JASON_SH3001_TAP_LAT;
+    data->event.doubleTapWin = JASON_SH3001_DOUBLETAP_WIN;
+    data->event.highGThr = JASON_SH3001_HIGH_G_THR;
+    data->event.highGTime = JASON_SH3001_HIGH_G_TIME;
+    data->event.freeFallThr = JASON_SH3001_FREE_FALL_THR;
+    data->event.freeFallTime = JASON_SH3001_FREE_FALL_TIME;
+    jason_sh3001_read_u8_prop(client, "event_tap_thr", &data->event.tapThr);
+    jason_sh3001_read_u8_prop(client, "event_tap_dur", &data->event.tapDur);
+    jason_sh3001_read_u8_prop(client, "event_tap_lat", &data->event.tapLat);
+    jason_sh3001_read_u8_prop(client, "event_doubletap_win", &data->event.doubleTapWin);
+    jason_sh3001_read_u8_prop(client, "event_high_g_thr", &data->event.highGThr);
+    jason_sh3001_read_u8_prop(client, "event_high_g_time", &data->event.highGTime);
+    jason_sh3001_read_u8_prop(client, "event_free_fall_thr", &data->event.freeFallThr);
+    jason_sh3001_read_u8_prop(client, "event_free_fall_time", &data->event.freeFallTime);
+    sensor->private_data = data;
+
+    ret = jason_sh3001_regmap_init(client, data);
+    if (ret)
+        return ret;
+
+    /* Initialize sh3001 sensor */
+    ret = jason_sh3001_sensor_init(client);
+    if(ret < 0)
+        return ret;
+    dev_info(&client->dev, "Sensor initialization succeeded!\n");
+
+    return ret;
+}
+
+/* SENSOR_EVENT_* 与 INTERRUPT_EN_0 位的对应关系，自由落体在 INTERRUPT_EN_1 中单独处理 */
+static const struct {
+    unsigned int event;
+    uint8_t int0;
+} jason_sh3001_event_table[] = {
+    { SENSOR_EVENT_SINGLE_TAP, INT0_SINGLE_TAP },
+    { SENSOR_EVENT_DOUBLE_TAP, INT0_DOUBLE_TAP },
+    { SENSOR_EVENT_HIGH_G,     INT0_HIGH_G },
+    { SENSOR_EVENT_ORIENT,     INT0_ORIENT },
+    { SENSOR_EVENT_FLAT,       INT0_FLAT },
+};
+
+/*
+ * 按当前的使用者配置 FIFO 和中断。数据中断（FIFO 水位或数据就绪）只在有功能采集数据时使能，
+ * 只使能了事件时芯片只在事件发生时产生中断，FIFO 切到 bypass 不再缓存。
+ * 运动门控和事件中断锁存，由采集路径读状态寄存器判断并清除。
+ * reset 为真时无论状态是否变化都重新配置 FIFO（清空其中的旧数据）。调用者需持有主设备的 sensor_mutex。
+ */
+static int jason_sh3001_update_irq_locked(struct i2c_client *client, bool reset)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    FifoConfig fifo = data->fifo;
+    bool streaming = sensor->acq_count > (data->events ? 1 : 0);
+    uint8_t config = 0, en0 = 0, en1 = 0;
+    int i;
+
+    if (data->fifo.mode != FIFO_MODE_BYPASS && (reset || streaming != data->streaming)) {
+        if (!streaming)
+            fifo.mode = FIFO_MODE_BYPASS;
+        if (configureFifo(client, &fifo) == JASON_SH3001_FALSE) {
+            dev_err(&client->dev, "Configure fifo error!\n");
+            return JASON_SH3001_FALSE;
+        }
+    }
+    data->streaming = streaming;
+
+    if (streaming && sensor->pdata->irq_enable) {
+        if (data->fifo.mode != FIFO_MODE_BYPASS) {
+            en1 = INT1_FIFO_WATERMARK;
+        } else if (data->drdy) {
+            /* 锁存数据就绪中断，读取数据时一并读状态寄存器清除，避免漏掉电平 */
+            config = INT_CONFIG_LATCH;
+            en1 = INT1_ACC_DRDY;
+        }
+    }
+
+    if (data->motion_gate)
+        en0 |= INT0_ACT | INT0_INACT;
+    for (i = 0; i < ARRAY_SIZE(jason_sh3001_event_table); i++) {
+        if (data->events & jason_sh3001_event_table[i].event)
+            en0 |= jason_sh3001_event_table[i].int0;
+    }
+    if (data->events & SENSOR_EVENT_FREE_FALL)
+        en1 |= INT1_FREE_FALL;
+    if (en0 || (en1 & INT1_FREE_FALL))
+        config = INT_CONFIG_LATCH;
+
+    /* 寄存器带缓存，没有变化的不会写入 */
+    if (configureInterrupt(client, config, en0, en1) == JASON_SH3001_FALSE) {
+        dev_err(&client->dev, "Configure interrupt error!\n");
+        return JASON_SH3001_FALSE;
+    }
+
+    return JASON_SH3001_TRUE;
+}
+
+// 主设备或任一从设备第一次打开时调用 enable = 1，全部关闭后调用 enable = 0
+int jason_sh3001_core_active(struct i2c_client *client, int enable, int rate)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    FifoConfig fifo = data->fifo;
+    int ret = JASON_SH3001_TRUE;
+
+    dev_info(&client->dev, "Enter sensor_active.\n");
+
+    mutex_lock(&sensor->sensor_mutex);
+    if (enable) {
+        /* 重新打开时按运动状态处理，等待芯片再次报告无活动；打开时清空 FIFO 重新开始缓存 */
+        data->idle = false;
+        ret = jason_sh3001_update_irq_locked(client, true);
+    } else {
+        data->streaming = false;
+        if (data->fifo.mode != FIFO_MODE_BYPASS) {
+            fifo.mode = FIFO_MODE_BYPASS;
+            if (configureFifo(client, &fifo) == JASON_SH3001_FALSE) {
+                dev_err(&client->dev, "Configure fifo error!\n");
+                ret = JASON_SH3001_FALSE;
+            }
+        }
+        if (configureInterrupt(client, 0, 0, 0) == JASON_SH3001_FALSE) {
+            dev_err(&client->dev, "Configure interrupt error!\n");
+            ret = JASON_SH3001_FALSE;
+        }
+    }
+    mutex_unlock(&sensor->sensor_mutex);
+
+    return ret;
+}
+
+// 加速度计的 set_events 回调，使用者变化时也会被调用
+int jason_sh3001_core_set_events(struct sensor_private_data *sensor, unsigned int events)
+{
+    struct jason_sh3001_data *data = sensor->private_data;
+    int ret;
+
+    mutex_lock(&sensor->sensor_mutex);
+    data->events = events;
+    ret = jason_sh3001_update_irq_locked(sensor->client, false);
+    mutex_unlock(&sensor->sensor_mutex);
+
+    return ret == JASON_SH3001_FALSE ? -EIO : 0;
+}
+
+/* 加速度计数字低通的截止频率为 ODR 的倍数（千分比），从高到低排列 */
+static const struct {
+    AccLPFCutoff cutoff;
+    int permille;
+} jason_sh3001_acc_lpf_table[] = {
+    { ACC_LPF_CUTOFF_0_40, 400 },
+    { ACC_LPF_CUTOFF_0_25, 250 },
+    { ACC_LPF_CUTOFF_0_11, 110 },
+    { ACC_LPF_CUTOFF_0_04,  40 },
+    { ACC_LPF_CUTOFF_0_02,  20 },
+};
+
+// 选择不超过上报频率一半的最大截止频率，降频上报时抑制混叠
+static AccLPFCutoff jason_sh3001_acc_lpf(int odr_hz, int report_hz)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(jason_sh3001_acc_lpf_table); i++) {
+        if (odr_hz * jason_sh3001_acc_lpf_table[i].permille <= report_hz * 500)
+            return jason_sh3001_acc_lpf_table[i].cutoff;
+    }
+
+    return ACC_LPF_CUTOFF_0_02;
+}
+
+static int jason_sh3001_fifo_drain(struct i2c_client *client, bool watermark);
+
+/*
+ * 按加速度计和陀螺仪请求的上报频率配置芯片，可以在采集运行中调用，不清空 FIFO。
+ * FIFO 采集运行中 ODR 改变时先读空 FIFO，按原 ODR 推算这些帧的时间戳，之后的帧才使用新的采样周期。
+ * 只轮询数据寄存器时两者的 ODR 各自独立；FIFO 的每帧包含全部数据、数据就绪中断跟随加速度计，
+ * 这两种模式下两者使用其中较高的 ODR，较低的一方由 jason_sensor_sample_due 降频。
+ * FIFO 水位线按 ODR 重新计算，保持批量上报的延时不变。
+ * 运动门控处于静止状态时加速度计使用 JASON_SH3001_IDLE_ODR_HZ，陀螺仪已被芯片关闭。
+ * 角度传感器打开或 IIO 缓冲区使能时加速度计和陀螺仪都不低于它们请求的频率，融合和 IIO 使用每一帧数据。
+ * 调用者需持有主设备的 sensor_mutex。
+ */
+static int jason_sh3001_apply_rate_locked(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    int acc_index, gyro_index;
+    int frames, watermark;
+    int ret = JASON_SH3001_FALSE;
+
+    if (data->suspended)
+        return JASON_SH3001_TRUE;
+
+    if (data->idle) {
+        acc_index = jason_sh3001_odr_index(JASON_SH3001_IDLE_ODR_HZ);
+        gyro_index = 0;
+    } else {
+        acc_index = jason_sh3001_odr_index(data->acc_hz);
+        gyro_index = jason_sh3001_odr_index(data->gyro_hz);
+        if (data->angle_hz) {
+            acc_index = max(acc_index, jason_sh3001_odr_index(data->angle_hz));
+            gyro_index = max(gyro_index, jason_sh3001_odr_index(data->angle_hz));
+        }
+        if (data->iio_hz) {
+            acc_index = max(acc_index, jason_sh3001_odr_index(data->iio_hz));
+            gyro_index = max(gyro_index, jason_sh3001_odr_index(data->iio_hz));
+        }
+    }
+    if (data->fifo.mode != FIFO_MODE_BYPASS || data->drdy)
+        acc_index = gyro_index = max(acc_index, gyro_index);
+
+    if (data->fifo.mode != FIFO_MODE_BYPASS && data->streaming &&
+        data->period_ns != jason_sh3001_odr_table[acc_index].period_ns &&
+        jason_sh3001_fifo_drain(client, false) == JASON_SH3001_FALSE)
+        goto out;
+
+    /* 寄存器带缓存，ODR 或截止频率没有变化的寄存器不会写入 */
+    if(jason_sh3001_update_bits(client, ACC_CONFIG_1, ACC_CONFIG_1_MASK,
+            jason_sh3001_odr_table[acc_index].acc_odr) == JASON_SH3001_FALSE)
+        goto out;
+
+    if(jason_sh3001_update_bits(client, ACC_CONFIG_3, 0xE0,
+            jason_sh3001_acc_lpf(jason_sh3001_odr_table[acc_index].hz, data->acc_hz) << 5) == JASON_SH3001_FALSE)
+        goto out;
+
+    if(jason_sh3001_update_bits(client, GYRO_CONFIG_1, GYRO_CONFIG_1_MASK,
+            jason_sh3001_odr_table[gyro_index].gyro_odr) == JASON_SH3001_FALSE)
+        goto out;
+
+    sensor->pdata->odr_hz = jason_sh3001_odr_table[acc_index].hz;
+    data->period_ns = jason_sh3001_odr_table[acc_index].period_ns;
+
+    if (data->fifo.mode != FIFO_MODE_BYPASS) {
+        frames = clamp_t(s64, div64_s64(data->fifo_latency_ns, data->period_ns),
+            1, FIFO_DEPTH_WORDS * 2 / data->frame_size);
+        watermark = frames * data->frame_size / 2;
+        if (watermark != data->fifo.watermark) {
+            if(jason_sh3001_write_reg(client, FIFO_CONFIG_1, watermark & 0xFF) == JASON_SH3001_FALSE)
+                goto out;
+            if(jason_sh3001_update_bits(client, FIFO_CONFIG_2, FIFO_WATERMARK_H_MASK,
+                    (watermark >> 8) & FIFO_WATERMARK_H_MASK) == JASON_SH3001_FALSE)
+                goto out;
+            data->fifo.watermark = watermark;
+        }
+    }
+    ret = JASON_SH3001_TRUE;
+    /* 运动门控在采集路径中也会调用这里，只输出调试信息 */
+    dev_dbg(&client->dev, "acc odr %dHz, gyro odr %dHz\n",
+        jason_sh3001_odr_table[acc_index].hz, jason_sh3001_odr_table[gyro_index].hz);
+
+out:
+    return ret;
+}
+
+static int jason_sh3001_apply_rate(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    int ret;
+
+    mutex_lock(&sensor->sensor_mutex);
+    ret = jason_sh3001_apply_rate_locked(client);
+    mutex_unlock(&sensor->sensor_mutex);
+
+    return ret;
+}
+
+// IIO 缓冲区请求的频率，0 表示缓冲区未使能，与 misc 设备请求的频率一起决定 ODR，可以在采集运行中调用
+int jason_sh3001_core_set_iio_rate(struct i2c_client *client, int hz)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+
+    data->iio_hz = hz;
+
+    return jason_sh3001_apply_rate(client);
+}
+
+// 加速度计、陀螺仪和角度传感器的 set_rate 回调，分别设置各自的上报频率
+int jason_sh3001_core_set_rate(struct sensor_private_data *sensor, int period_us)
+{
+    struct jason_sh3001_data *data = sensor->private_data;
+    int hz = DIV_ROUND_UP(USEC_PER_SEC, period_us);
+
+    if (sensor->type == SENSOR_TYPE_GYROSCOPE)
+        data->gyro_hz = hz;
+    else if (sensor->type == SENSOR_TYPE_ANGLE)
+        data->angle_hz = hz;
+    else
+        data->acc_hz = hz;
+
+    if (jason_sh3001_apply_rate(sensor->client) == JASON_SH3001_FALSE)
+        return -EIO;
+
+    return 0;
+}
+
+// 按当前 ODR 把 frames 帧换算为水位线对应的时间，水位线与 ODR 一起写入芯片，可以在采集运行中调用
+int jason_sh3001_core_set_fifo_frames(struct i2c_client *client, int frames)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    int ret;
+
+    mutex_lock(&sensor->sensor_mutex);
+    data->fifo_latency_ns = (s64)frames * data->period_ns;
+    ret = jason_sh3001_apply_rate_locked(client);
+    mutex_unlock(&sensor->sensor_mutex);
+
+    return ret;
+}
+
+/*
+ * 角度传感器的 active 回调：打开时从下一帧重新初始化姿态，set_rate 随后设置融合频率；
+ * 关闭时不再限制加速度计和陀螺仪的 ODR。
+ */
+int jason_sh3001_core_angle_active(struct i2c_client *client, int enable, int rate)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+
+    mutex_lock(&sensor->sensor_mutex);
+    data->fusion.init = true;
+    if (!enable)
+        data->angle_hz = 0;
+    mutex_unlock(&sensor->sensor_mutex);
+
+    if (enable)
+        return JASON_SH3001_TRUE;
+
+    return jason_sh3001_apply_rate(client);
+}
+
+/*
+ * runtime 挂起：陀螺仪掉电，加速度计切到低功耗模式，加速度计和陀螺仪降到最低 ODR，关闭温度传感器。
+ * 只改配置寄存器，恢复时不需要重新初始化，寄存器缓存保持与芯片一致。
+ */
+int jason_sh3001_core_suspend(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    int ret = JASON_SH3001_FALSE;
+
+    mutex_lock(&sensor->sensor_mutex);
+
+    /* 陀螺仪是芯片中功耗最大的部分，只降 ODR 省不了多少电 */
+    if(jason_sh3001_update_bits(client, POWER_MODE, POWER_MODE_MASK,
+            POWER_MODE_GYRO_DOWN) == JASON_SH3001_FALSE)
+        goto out;
+
+    if(jason_sh3001_update_bits(client, GYRO_CONFIG_1, GYRO_CONFIG_1_MASK,
+            jason_sh3001_odr_table[0].gyro_odr) == JASON_SH3001_FALSE)
+        goto out;
+
+    if(jason_sh3001_update_bits(client, ACC_CONFIG_1, ACC_CONFIG_1_MASK,
+            jason_sh3001_odr_table[0].acc_odr) == JASON_SH3001_FALSE)
+        goto out;
+
+    if(jason_sh3001_update_bits(client, ACC_CONFIG_0, 0x80,
+            ACC_WORK_MODE_LOW_POWER << 7) == JASON_SH3001_FALSE)
+        goto out;
+
+    if(jason_sh3001_update_bits(client, TEMP_SENSOR_CONFIG_0, 0x80,
+            TEMP_SENSOR_DIGITAL_DISABLE << 7) == JASON_SH3001_FALSE)
+        goto out;
+
+    data->suspended = true;
+    ret = JASON_SH3001_TRUE;
+
+out:
+    mutex_unlock(&sensor->sensor_mutex);
+
+    return ret;
+}
+
+// runtime 恢复：陀螺仪上电、回到正常模式，按挂起期间记录的上报频率重新配置 ODR
+int jason_sh3001_core_resume(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    int ret = JASON_SH3001_FALSE;
+
+    mutex_lock(&sensor->sensor_mutex);
+
+    if(jason_sh3001_update_bits(client, TEMP_SENSOR_CONFIG_0, 0x80,
+            TEMP_SENSOR_DIGITAL_ENABLE << 7) == JASON_SH3001_FALSE)
+        goto out;
+
+    if(jason_sh3001_update_bits(client, ACC_CONFIG_0, 0x80,
+            ACC_WORK_MODE_NORMAL << 7) == JASON_SH3001_FALSE)
+        goto out;
+
+    if(jason_sh3001_update_bits(client, POWER_MODE, POWER_MODE_MASK,
+            POWER_MODE_NORMAL) == JASON_SH3001_FALSE)
+        goto out;
+
+    data->suspended = false;
+    data->idle = false;
+    ret = JASON_SH3001_TRUE;
+
+out:
+    mutex_unlock(&sensor->sensor_mutex);
+    if (ret == JASON_SH3001_FALSE)
+        return ret;
+
+    return jason_sh3001_apply_rate(client);
+}
+
+// 把一帧数据分发给已打开的加速度计、陀螺仪、温度传感器和角度传感器
+static void jason_sh3001_dispatch(struct jason_sh3001_data *data,
+            const uint8_t *frame, ktime_t timestamp)
+{
+    /* 温度与运动数据在同一帧中，先按本帧的温度更新零偏 */
+    int temp_mdeg = jason_sh3001_temp_mdeg(data, frame + JASON_SH3001_TEMP_OFFSET);
+
+    jason_sensor_set_temperature(data->acc, temp_mdeg);
+    if (data->gyro)
+        jason_sensor_set_temperature(data->gyro, temp_mdeg);
+
+    if (data->acc->status_cur == SENSOR_ON &&
+        jason_sensor_sample_due(data->acc, timestamp))
+        jason_sh3001_acc_report(data->acc, frame + JASON_SH3001_ACC_OFFSET, timestamp);
+
+    /* 静止时陀螺仪已关闭，数据寄存器中是关闭前的旧值 */
+    if (data->gyro && data->gyro->status_cur == SENSOR_ON && !data->idle &&
+        jason_sensor_sample_due(data->gyro, timestamp))
+        jason_sh3001_gyro_report(data->gyro, frame + JASON_SH3001_GYRO_OFFSET, timestamp);
+
+    if (data->temp && data->temp->status_cur == SENSOR_ON &&
+        jason_sensor_sample_due(data->temp, timestamp))
+        jason_sh3001_temp_report(data->temp, frame + JASON_SH3001_TEMP_OFFSET, timestamp);
+
+    if (data->angle && data->angle->status_cur == SENSOR_ON && !data->idle)
+        jason_sh3001_angle_update(data, frame, timestamp);
+
+    if (data->indio_dev)
+        jason_sh3001_iio_push(data, frame, timestamp);
+}
+
+// 读空 FIFO：先读 FIFO 中的数据量，再用一次 i2c 传输读出全部完整的帧，watermark 表示由水位线中断触发
+static int jason_sh3001_fifo_drain(struct i2c_client *client, bool watermark)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    uint8_t status[2];
+    int words, frames, anchor, i;
+    ktime_t timestamp;
+
+    if (jason_sh3001_read_regs(client, FIFO_STATUS_0, 2, status) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+    timestamp = ktime_get_boottime();
+
+    words = ((status[1] & FIFO_COUNT_H_MASK) << 8) | status[0];
+    frames = min(words, FIFO_DEPTH_WORDS) * 2 / data->frame_size;
+    if (frames == 0)
+        return JASON_SH3001_TRUE;
+
+    if (jason_sh3001_read_fifo(client, frames * data->frame_size,
+            data->fifo_buf) == JASON_SH3001_FALSE)
+        return JASON_SH3001_FALSE;
+
+    /*
+     * 中断模式下水位线中断的时间戳对应达到水位线的那一帧，中断之后到达的帧按采样周期往后推；
+     * 轮询模式、修改 ODR 前读空 FIFO 或 FIFO 中的帧不到水位线时（其他中断触发的读取），
+     * 读出数据量的时刻对应最后一帧。
+     * 其余帧按采样周期依次推算。
+     */
+    anchor = DIV_ROUND_UP(data->fifo.watermark * 2, data->frame_size);
+    if (watermark && sensor->pdata->irq_enable && anchor > 0 && frames >= anchor) {
+        timestamp = sensor->timestamp;
+        anchor--;
+    } else {
+        anchor = frames - 1;
+    }
+
+    for (i = 0; i < frames; i++)
+        jason_sh3001_dispatch(data, data->fifo_buf + i * data->frame_size,
+            ktime_add_ns(timestamp, (s64)(i - anchor) * data->period_ns));
+
+    return JASON_SH3001_TRUE;
+}
+
+/*
+ * 运动门控：无活动时加速度计降到低 ODR，陀螺仪由芯片关闭；活动时立即恢复请求的频率。
+ * 从运动到恢复全速的延时不超过活动检测时间（ACT_INT_TIME 个低 ODR 采样）加一次配置写入。
+ * 在采集路径中调用，已持有主设备的 sensor_mutex。
+ */
+static void jason_sh3001_motion(struct i2c_client *client, uint8_t status0)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    bool idle = data->idle;
+
+    if (status0 & INT0_ACT)
+        idle = false;
+    else if (status0 & INT0_INACT)
+        idle = true;
+    if (idle == data->idle)
+        return;
+
+    data->idle = idle;
+    dev_dbg(&client->dev, "%s\n", idle ? "inactive" : "active");
+    jason_sh3001_apply_rate_locked(client);
+}
+
+// 上报状态寄存器中使能了的事件，每个事件一个 MSC_GESTURE
+static void jason_sh3001_events(struct jason_sh3001_data *data,
+            uint8_t status0, uint8_t status1, ktime_t timestamp)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(jason_sh3001_event_table); i++) {
+        if ((data->events & jason_sh3001_event_table[i].event) &&
+            (status0 & jason_sh3001_event_table[i].int0))
+            jason_sensor_report_event(data->acc, jason_sh3001_event_table[i].event, timestamp);
+    }
+
+    if ((data->events & SENSOR_EVENT_FREE_FALL) && (status1 & INT1_FREE_FALL))
+        jason_sensor_report_event(data->acc, SENSOR_EVENT_FREE_FALL, timestamp);
+}
+
+// 处理运动门控和事件，status 为 INTERRUPT_STATUS_0/1
+static void jason_sh3001_status(struct i2c_client *client, const uint8_t *status)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+
+    if (data->events)
+        jason_sh3001_events(data, status[0], status[1], sensor->timestamp);
+    if (data->motion_gate)
+        jason_sh3001_motion(client, status[0]);
+}
+
+int jason_sh3001_core_report(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor = 
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    uint8_t buf[JASON_SH3001_BURST_SIZE] = {0};
+    bool status = data->motion_gate || data->events;
+    int len = sensor->ops->read_len;
+    int ret = JASON_SH3001_TRUE;
+
+    if (data->fifo.mode != FIFO_MODE_BYPASS) {
+        /* 先读出 FIFO 中按原 ODR 采集的数据，再切换 ODR；只有事件时 FIFO 不缓存数据 */
+        if (status &&
+            jason_sh3001_read_regs(client, INTERRUPT_STATUS_0, 2, buf) == JASON_SH3001_FALSE)
+            return JASON_SH3001_FALSE;
+        if (data->streaming)
+            ret = jason_sh3001_fifo_drain(client, true);
+        if (status)
+            jason_sh3001_status(client, buf);
+        return ret;
+    }
+
+    /* 一次读出 ACC_XDATA_L ~ TEMP_DATA_H，三种数据属于同一采样时刻，
+     * 数据就绪中断、运动门控或使能了事件时继续读到 INTERRUPT_STATUS_1 */
+    if (data->drdy || status)
+        len = JASON_SH3001_BURST_SIZE;
+    ret = jason_sh3001_read_regs(client, sensor->ops->read_reg, len, buf);
+    if (ret < 0) {
+        dev_err(&client->dev, "%s:%d jason_sh3001_read_regs error!\n", __func__, __LINE__);
+        return ret;
+    }
+
+    if (!data->drdy || (buf[JASON_SH3001_STATUS1_OFFSET] & INT1_ACC_DRDY))
+        jason_sh3001_dispatch(data, buf, sensor->timestamp);
+
+    if (status)
+        jason_sh3001_status(client, buf + JASON_SH3001_STATUS0_OFFSET);
+
+    return 0;
+}
+
+// 注册从设备，从设备与主设备共用芯片数据
+static struct sensor_private_data *jason_sh3001_add_companion(struct i2c_client *client,
+            struct sensor_operate *ops)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct sensor_private_data *companion;
+
+    companion = jason_sensor_register_companion(client, ops, sensor->private_data);
+    if (IS_ERR(companion)) {
+        dev_err(&client->dev, "register %s failed: %ld\n", ops->name, PTR_ERR(companion));
+        return NULL;
+    }
+
+    return companion;
+}
+
+static int sh3001_probe(struct i2c_client *client, const struct i2c_device_id *dev_id)
+{
+    struct sensor_private_data *sensor;
+    struct sensor_private_data *gyro, *temp, *angle;
+    struct jason_sh3001_data *data;
+    ktime_t start = ktime_get();
+    int ret;
+
+    pr_info("sh3001 driver module loaded.\n");
+
+    ret = jason_sensor_register_device(client, NULL, dev_id, &jason_sh3001_acc_ops);
+    if (ret)
+        return ret;
+
+    sensor = (struct sensor_private_data *)i2c_get_clientdata(client);
+    data = sensor->private_data;
+
+    /* 从设备只注册 input/misc 设备，不访问芯片，直接依次注册；整个 probe 已经是异步的。
+     * 从设备注册失败时只是少了对应的功能，加速度计仍然可用 */
+    gyro = jason_sh3001_add_companion(client, &jason_sh3001_gyro_ops);
+    temp = jason_sh3001_add_companion(client, &jason_sh3001_temp_ops);
+    angle = jason_sh3001_add_companion(client, &jason_sh3001_angle_ops);
+
+    /* IIO 与 input/misc 设备并存，注册失败不影响原有的接口 */
+    ret = jason_sh3001_iio_init(client);
+    if (ret)
+        dev_err(&client->dev, "register iio device failed: %d\n", ret);
+
+    if (gyro)
+        jason_sensor_set_scale(gyro, data->gyro_scale_nano);
+
+    mutex_lock(&sensor->sensor_mutex);
+    data->gyro = gyro;
+    data->temp = temp;
+    data->angle = angle;
+    mutex_unlock(&sensor->sensor_mutex);
+
+    dev_info(&client->dev, "probe done in %lldus\n", ktime_us_delta(ktime_get(), start));
+
+    return 0;
+}
+
+static int sh3001_remove(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    struct sensor_private_data *gyro, *temp, *angle;
+    int ret;
+
+    pr_info("sh3001 driver module unloaded.\n");
+
+    jason_sh3001_iio_remove(client);
+
+    mutex_lock(&sensor->sensor_mutex);
+    gyro = data->gyro;
+    temp = data->temp;
+    angle = data->angle;
+    data->gyro = NULL;
+    data->temp = NULL;
+    data->angle = NULL;
+    mutex_unlock(&sensor->sensor_mutex);
+
+    /* 先注销主设备停止采集，再注销从设备 */
+    ret = jason_sensor_unregister_device(client, NULL, &jason_sh3001_acc_ops);
+    jason_sensor_unregister_companion(gyro);
+    jason_sensor_unregister_companion(temp);
+    jason_sensor_unregister_companion(angle);
+
+    return ret;
+}
+
+/* 这里的 ACCEL_ID_SH3001 一定要有，用于与 linux/sensor-dev.h 配合使用。
+ * jason_sh3001_acc 为旧的名字，保留以兼容已有的设备树 */
+static const struct i2c_device_id sh3001_id_table[] = {
+    {"jason_sh3001", ACCEL_ID_SH3001},
+    {"jason_sh3001_acc", ACCEL_ID_SH3001},
+    {},
+};
+
+static struct i2c_driver sh3001_driver = {
+	/* Standard driver model interfaces */
+	.probe = sh3001_probe, 
+	.remove = sh3001_remove, 
+    .id_table = sh3001_id_table,
+    .driver = {
+        .name = "jason_sh3001",
+        .owner = THIS_MODULE,
+        /*
+         * 探测中的 i2c 传输不阻塞其他驱动的探测，加快启动。
+         * 多个实例可能同时探测，ops 只读且经 sensor->ops 按实例保存，探测不能再引入全局可写状态
+         */
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
+        /* 没有功能打开时芯片 autosuspend 进入低功耗 */
+        .pm = &jason_sensor_pm_ops,
+    },
+};
+
+/* This will create the init and exit function automatically */
+module_i2c_driver(sh3001_driver);
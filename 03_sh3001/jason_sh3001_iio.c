@@ -0,0 +1,396 @@
+#include <linux/kernel.h>
+#include <linux/i2c.h>
+#include <linux/types.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/kfifo_buf.h>
+#include <linux/iio/sysfs.h>
+#include "jason_sh3001.h"
+
+/*
+ * SH3001 的 IIO 前端，与 input/misc 设备并存。
+ * 数据来自核心已有的采集路径（数据就绪中断、FIFO 水位中断或轮询），每帧在分发时
+ * 同时推入 IIO 的软件缓冲区，因此这里不再注册 trigger，使用 kfifo 缓冲区即可。
+ * sampling_frequency 与 misc 设备的 SET_PERIOD_US 一样只是一个请求：缓冲区使能时芯片 ODR 和主设备的
+ * 轮询周期都不低于它，多出的帧按请求的频率丢弃，读出的是缓冲区实际得到的频率。
+ */
+
+enum {
+    JASON_SH3001_SCAN_ACC_X,
+    JASON_SH3001_SCAN_ACC_Y,
+    JASON_SH3001_SCAN_ACC_Z,
+    JASON_SH3001_SCAN_GYRO_X,
+    JASON_SH3001_SCAN_GYRO_Y,
+    JASON_SH3001_SCAN_GYRO_Z,
+    JASON_SH3001_SCAN_TEMP,
+    JASON_SH3001_SCAN_TIMESTAMP,
+};
+
+/* 每帧 14 字节，FIFO 深度可以容纳的最大帧数 */
+#define JASON_SH3001_HWFIFO_MAX         (FIFO_DEPTH_WORDS * 2 / JASON_SH3001_FRAME_SIZE)
+
+struct jason_sh3001_iio {
+    struct sensor_private_data *sensor;     // 主设备
+    int hz;                                 // 请求的频率，0 表示每帧都推入缓冲区，由 mlock 保护
+    ktime_t next;                           // 下一帧推入缓冲区的时刻，在主设备的 sensor_mutex 中读写
+};
+
+#define JASON_SH3001_IIO_CHAN(_type, _axis, _addr, _si) {               \
+    .type = _type,                                                      \
+    .modified = 1,                                                      \
+    .channel2 = IIO_MOD_##_axis,                                        \
+    .address = _addr,                                                   \
+    .info_mask_separate = BIT(IIO_CHAN_INFO_RAW),                       \
+    .info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),               \
+    .info_mask_shared_by_all = BIT(IIO_CHAN_INFO_SAMP_FREQ),            \
+    .scan_index = _si,                                                  \
+    .scan_type = {                                                      \
+        .sign = 's',                                                    \
+        .realbits = 16,                                                 \
+        .storagebits = 16,                                              \
+        .endianness = IIO_LE,                                           \
+    },                                                                  \
+}
+
+/* scan_index 的顺序与数据寄存器（以及 FIFO 中每帧）的布局一致 */
+static const struct iio_chan_spec jason_sh3001_iio_channels[] = {
+    JASON_SH3001_IIO_CHAN(IIO_ACCEL, X, ACC_XDATA_L, JASON_SH3001_SCAN_ACC_X),
+    JASON_SH3001_IIO_CHAN(IIO_ACCEL, Y, ACC_YDATA_L, JASON_SH3001_SCAN_ACC_Y),
+    JASON_SH3001_IIO_CHAN(IIO_ACCEL, Z, ACC_ZDATA_L, JASON_SH3001_SCAN_ACC_Z),
+    JASON_SH3001_IIO_CHAN(IIO_ANGL_VEL, X, GYRO_XDATA_L, JASON_SH3001_SCAN_GYRO_X),
+    JASON_SH3001_IIO_CHAN(IIO_ANGL_VEL, Y, GYRO_YDATA_L, JASON_SH3001_SCAN_GYRO_Y),
+    JASON_SH3001_IIO_CHAN(IIO_ANGL_VEL, Z, GYRO_ZDATA_L, JASON_SH3001_SCAN_GYRO_Z),
+    {
+        .type = IIO_TEMP,
+        .address = TEMP_DATA_L,
+        .info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |
+            BIT(IIO_CHAN_INFO_OFFSET) | BIT(IIO_CHAN_INFO_SCALE),
+        .info_mask_shared_by_all = BIT(IIO_CHAN_INFO_SAMP_FREQ),
+        .scan_index = JASON_SH3001_SCAN_TEMP,
+        .scan_type = {
+            .sign = 'u',
+            .realbits = 12,
+            .storagebits = 16,
+            .endianness = IIO_LE,
+        },
+    },
+    IIO_CHAN_SOFT_TIMESTAMP(JASON_SH3001_SCAN_TIMESTAMP),
+};
+
+/* 总是整帧推入缓冲区，由 IIO core 按用户选择的通道拆分 */
+static const unsigned long jason_sh3001_iio_scan_masks[] = {
+    BIT(JASON_SH3001_SCAN_TEMP + 1) - 1,
+    0,
+};
+
+static struct sensor_private_data *jason_sh3001_iio_sensor(struct iio_dev *indio_dev)
+{
+    struct jason_sh3001_iio *priv = iio_priv(indio_dev);
+
+    return priv->sensor;
+}
+
+// 缓冲区实际得到的频率：中断或 FIFO 模式下每个芯片采样一帧，只轮询数据寄存器时每次轮询一帧
+static int jason_sh3001_iio_delivered_hz(struct iio_dev *indio_dev)
+{
+    struct jason_sh3001_iio *priv = iio_priv(indio_dev);
+    struct sensor_private_data *sensor = priv->sensor;
+    struct jason_sh3001_data *data = sensor->private_data;
+    int frame_hz;
+
+    if (sensor->pdata->irq_enable || data->fifo.mode != FIFO_MODE_BYPASS)
+        frame_hz = sensor->pdata->odr_hz;
+    else
+        frame_hz = DIV_ROUND_CLOSEST(USEC_PER_SEC, sensor->pdata->poll_period_us);
+
+    if (!iio_buffer_enabled(indio_dev))
+        return priv->hz ? priv->hz : frame_hz;
+
+    return priv->hz ? min(priv->hz, frame_hz) : frame_hz;
+}
+
+// 把 IIO 请求的频率交给芯片 ODR 和主设备的轮询，hz 为 0 时取消，调用者持有 mlock
+static int jason_sh3001_iio_apply_rate(struct iio_dev *indio_dev, int hz)
+{
+    struct sensor_private_data *sensor = jason_sh3001_iio_sensor(indio_dev);
+
+    if (jason_sh3001_core_set_iio_rate(sensor->client, hz) == JASON_SH3001_FALSE)
+        return -EIO;
+    jason_sensor_set_acquire_period(sensor, hz ? DIV_ROUND_UP(USEC_PER_SEC, hz) : 0);
+
+    return 0;
+}
+
+static int jason_sh3001_iio_read_raw(struct iio_dev *indio_dev,
+            struct iio_chan_spec const *chan, int *val, int *val2, long mask)
+{
+    struct sensor_private_data *sensor = jason_sh3001_iio_sensor(indio_dev);
+    struct jason_sh3001_data *data = sensor->private_data;
+    uint8_t buf[2];
+    int ret;
+
+    switch (mask) {
+    case IIO_CHAN_INFO_RAW:
+        ret = iio_device_claim_direct_mode(indio_dev);
+        if (ret)
+            return ret;
+        /* 没有采集时芯片可能处于 autosuspend 的低功耗状态 */
+        ret = jason_sensor_pm_get(sensor);
+        if (ret) {
+            iio_device_release_direct_mode(indio_dev);
+            return ret;
+        }
+        ret = jason_sh3001_read_regs(sensor->client, chan->address, 2, buf);
+        jason_sensor_pm_put(sensor);
+        iio_device_release_direct_mode(indio_dev);
+        if (ret == JASON_SH3001_FALSE)
+            return -EIO;
+
+        if (chan->type == IIO_TEMP)
+            *val = ((buf[1] & 0x0F) << 8) | buf[0];
+        else
+            *val = (s16)((buf[1] << 8) | buf[0]);
+        return IIO_VAL_INT;
+
+    case IIO_CHAN_INFO_SCALE:
+        switch (chan->type) {
+        case IIO_ACCEL:
+            *val = 0;
+            *val2 = data->acc_scale_nano;
+            return IIO_VAL_INT_PLUS_NANO;
+        case IIO_ANGL_VEL:
+            *val = 0;
+            *val2 = data->gyro_scale_nano;
+            return IIO_VAL_INT_PLUS_NANO;
+        case IIO_TEMP:
+            /* 16 LSB/°C，单位为 0.001°C */
+            *val = 62;
+            *val2 = 500000;
+            return IIO_VAL_INT_PLUS_MICRO;
+        default:
+            return -EINVAL;
+        }
+
+    case IIO_CHAN_INFO_OFFSET:
+        /* (raw + offset) * scale：室温值对应 25°C */
+        *val = 25 * 16 - data->room_temp;
+        return IIO_VAL_INT;
+
+    case IIO_CHAN_INFO_SAMP_FREQ:
+        *val = jason_sh3001_iio_delivered_hz(indio_dev);
+        return IIO_VAL_INT;
+
+    default:
+        return -EINVAL;
+    }
+}
+
+static int jason_sh3001_iio_write_raw(struct iio_dev *indio_dev,
+            struct iio_chan_spec const *chan, int val, int val2, long mask)
+{
+    struct jason_sh3001_iio *priv = iio_priv(indio_dev);
+    int ret = 0;
+
+    if (mask != IIO_CHAN_INFO_SAMP_FREQ)
+        return -EINVAL;
+
+    if (val <= 0)
+        return -EINVAL;
+
+    /* 缓冲区使能和关闭都在 mlock 中进行；misc 设备请求的频率不受影响 */
+    mutex_lock(&indio_dev->mlock);
+    WRITE_ONCE(priv->hz, val);
+    if (iio_buffer_enabled(indio_dev))
+        ret = jason_sh3001_iio_apply_rate(indio_dev, val);
+    mutex_unlock(&indio_dev->mlock);
+
+    return ret;
+}
+
+// val 为帧数，按当前 ODR 换算为批量上报的延时，芯片的水位线随之更新，采集运行中也立即生效
+static int jason_sh3001_iio_set_watermark(struct iio_dev *indio_dev, unsigned int val)
+{
+    struct sensor_private_data *sensor = jason_sh3001_iio_sensor(indio_dev);
+    struct jason_sh3001_data *data = sensor->private_data;
+
+    if (data->fifo.mode == FIFO_MODE_BYPASS)
+        return 0;
+
+    val = clamp_t(unsigned int, val, 1, JASON_SH3001_HWFIFO_MAX);
+
+    if (jason_sh3001_core_set_fifo_frames(sensor->client, val) == JASON_SH3001_FALSE)
+        return -EIO;
+
+    return 0;
+}
+
+static int jason_sh3001_iio_postenable(struct iio_dev *indio_dev)
+{
+    struct jason_sh3001_iio *priv = iio_priv(indio_dev);
+    struct sensor_private_data *sensor = priv->sensor;
+    int ret;
+
+    mutex_lock(&sensor->sensor_mutex);
+    priv->next = 0;
+    mutex_unlock(&sensor->sensor_mutex);
+
+    if (priv->hz) {
+        ret = jason_sh3001_iio_apply_rate(indio_dev, priv->hz);
+        if (ret)
+            return ret;
+    }
+
+    ret = jason_sensor_acquire(sensor, SENSOR_ON);
+    if (ret && priv->hz)
+        jason_sh3001_iio_apply_rate(indio_dev, 0);
+
+    return ret;
+}
+
+static int jason_sh3001_iio_predisable(struct iio_dev *indio_dev)
+{
+    struct jason_sh3001_iio *priv = iio_priv(indio_dev);
+    int ret;
+
+    ret = jason_sensor_acquire(priv->sensor, SENSOR_OFF);
+    if (priv->hz)
+        jason_sh3001_iio_apply_rate(indio_dev, 0);
+
+    return ret;
+}
+
+static const struct iio_buffer_setup_ops jason_sh3001_iio_buffer_ops = {
+    .postenable = jason_sh3001_iio_postenable,
+    .predisable = jason_sh3001_iio_predisable,
+};
+
+static ssize_t jason_sh3001_hwfifo_enabled_show(struct device *dev,
+            struct device_attribute *attr, char *buf)
+{
+    struct sensor_private_data *sensor = jason_sh3001_iio_sensor(dev_to_iio_dev(dev));
+    struct jason_sh3001_data *data = sensor->private_data;
+
+    return sprintf(buf, "%d\n", data->fifo.mode != FIFO_MODE_BYPASS);
+}
+
+static ssize_t jason_sh3001_hwfifo_watermark_show(struct device *dev,
+            struct device_attribute *attr, char *buf)
+{
+    struct sensor_private_data *sensor = jason_sh3001_iio_sensor(dev_to_iio_dev(dev));
+    struct jason_sh3001_data *data = sensor->private_data;
+
+    return sprintf(buf, "%d\n", data->fifo.watermark * 2 / data->frame_size);
+}
+
+static IIO_CONST_ATTR_SAMP_FREQ_AVAIL("16 31 63 125 250 500 1000 2000 4000 8000");
+static IIO_CONST_ATTR(hwfifo_watermark_min, "1");
+static IIO_CONST_ATTR(hwfifo_watermark_max, __stringify(JASON_SH3001_HWFIFO_MAX));
+static IIO_DEVICE_ATTR(hwfifo_enabled, S_IRUGO,
+            jason_sh3001_hwfifo_enabled_show, NULL, 0);
+static IIO_DEVICE_ATTR(hwfifo_watermark, S_IRUGO,
+            jason_sh3001_hwfifo_watermark_show, NULL, 0);
+
+static struct attribute *jason_sh3001_iio_attrs[] = {
+    &iio_const_attr_sampling_frequency_available.dev_attr.attr,
+    NULL,
+};
+
+static const struct attribute_group jason_sh3001_iio_attr_group = {
+    .attrs = jason_sh3001_iio_attrs,
+};
+
+static const struct attribute *jason_sh3001_iio_fifo_attrs[] = {
+    &iio_const_attr_hwfifo_watermark_min.dev_attr.attr,
+    &iio_const_attr_hwfifo_watermark_max.dev_attr.attr,
+    &iio_dev_attr_hwfifo_watermark.dev_attr.attr,
+    &iio_dev_attr_hwfifo_enabled.dev_attr.attr,
+    NULL,
+};
+
+static const struct iio_info jason_sh3001_iio_info = {
+    .read_raw = jason_sh3001_iio_read_raw,
+    .write_raw = jason_sh3001_iio_write_raw,
+    .attrs = &jason_sh3001_iio_attr_group,
+    .hwfifo_set_watermark = jason_sh3001_iio_set_watermark,
+};
+
+// 由核心在分发每帧数据时调用，调用者持有主设备的 sensor_mutex
+void jason_sh3001_iio_push(struct jason_sh3001_data *data, const uint8_t *frame, ktime_t timestamp)
+{
+    /* 7 个 16 位通道，时间戳按 8 字节对齐放在最后，中间的填充字节清零，避免把栈上的数据带给用户态 */
+    uint8_t scan[ALIGN(JASON_SH3001_FRAME_SIZE, sizeof(s64)) + sizeof(s64)] __aligned(8) = {0};
+    struct jason_sh3001_iio *priv = iio_priv(data->indio_dev);
+    int hz = READ_ONCE(priv->hz);
+
+    if (!iio_buffer_enabled(data->indio_dev))
+        return;
+
+    /* 芯片或轮询比请求的频率快时（misc 设备请求了更高的频率）按请求的频率降频 */
+    if (!jason_sensor_due(&priv->next, hz ? div_s64(NSEC_PER_SEC, hz) : 0, timestamp))
+        return;
+
+    memcpy(scan, frame, JASON_SH3001_FRAME_SIZE);
+    iio_push_to_buffers_with_timestamp(data->indio_dev, scan, ktime_to_ns(timestamp));
+}
+
+int jason_sh3001_iio_init(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    struct jason_sh3001_iio *priv;
+    struct iio_dev *indio_dev;
+    struct iio_buffer *buffer;
+    int ret;
+
+    indio_dev = devm_iio_device_alloc(&client->dev, sizeof(*priv));
+    if (!indio_dev)
+        return -ENOMEM;
+
+    priv = iio_priv(indio_dev);
+    priv->sensor = sensor;
+
+    indio_dev->dev.parent = &client->dev;
+    indio_dev->name = "sh3001";
+    indio_dev->channels = jason_sh3001_iio_channels;
+    indio_dev->num_channels = ARRAY_SIZE(jason_sh3001_iio_channels);
+    indio_dev->available_scan_masks = jason_sh3001_iio_scan_masks;
+    indio_dev->info = &jason_sh3001_iio_info;
+    indio_dev->modes = INDIO_DIRECT_MODE | INDIO_BUFFER_SOFTWARE;
+    indio_dev->setup_ops = &jason_sh3001_iio_buffer_ops;
+    /* 与 misc 设备的采样时间戳使用同一时钟 */
+    indio_dev->clock_id = CLOCK_BOOTTIME;
+
+    buffer = devm_iio_kfifo_allocate(&client->dev);
+    if (!buffer)
+        return -ENOMEM;
+    iio_device_attach_buffer(indio_dev, buffer);
+    if (data->fifo.mode != FIFO_MODE_BYPASS)
+        iio_buffer_set_attrs(buffer, jason_sh3001_iio_fifo_attrs);
+
+    ret = iio_device_register(indio_dev);
+    if (ret)
+        return ret;
+
+    mutex_lock(&sensor->sensor_mutex);
+    data->indio_dev = indio_dev;
+    mutex_unlock(&sensor->sensor_mutex);
+
+    return 0;
+}
+
+void jason_sh3001_iio_remove(struct i2c_client *client)
+{
+    struct sensor_private_data *sensor =
+        (struct sensor_private_data *)i2c_get_clientdata(client);
+    struct jason_sh3001_data *data = sensor->private_data;
+    struct iio_dev *indio_dev;
+
+    mutex_lock(&sensor->sensor_mutex);
+    indio_dev = data->indio_dev;
+    data->indio_dev = NULL;
+    mutex_unlock(&sensor->sensor_mutex);
+
+    if (indio_dev)
+        iio_device_unregister(indio_dev);
+}
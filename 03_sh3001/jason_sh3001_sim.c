@@ -0,0 +1,242 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/i2c.h>
+#include <linux/gpio.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include "jason_sh3001.h"
+
+/*
+ * 模拟的 SH3001，作为 i2c 从设备后端（与 i2c-slave-eeprom 相同的用法），供 jason_sensor_bench 使用。
+ * 在支持从模式的 i2c 控制器上创建：
+ *   echo slave-sh3001 0x1036 > /sys/bus/i2c/devices/i2c-X/new_device
+ * 驱动所在的主控制器与它接在同一条总线上（QEMU 中的两个控制器或板上回环），设备树照常描述 SH3001。
+ *
+ * 只模拟 bypass 模式：FIFO 状态始终为空，中断状态只有 INTERRUPT_STATUS_1 的 INT1_ACC_DRDY，
+ * 产生新样本时置位，读 INTERRUPT_STATUS_1 后清除（与锁存模式下读状态清中断相同）。
+ * 不指定 irq_gpio 时每次读数据寄存器产生一个新样本（轮询模式）；
+ * 指定 irq_gpio 时按 ACC_CONFIG_1 的 ODR 产生新样本并拉高该 GPIO，读数据寄存器后拉低，
+ * 把它接到驱动的中断引脚即可测试数据就绪中断模式。
+ */
+
+static int irq_gpio = -1;
+module_param(irq_gpio, int, 0444);
+MODULE_PARM_DESC(irq_gpio, "GPIO raised on each new sample at the configured ODR, -1 to sample on read");
+
+#define JASON_SH3001_SIM_ROOM_TEMP  (0x500)     // 出厂室温值，温度数据也使用它，即 25°C
+#define JASON_SH3001_SIM_ONE_G_2G   (16384)     // ±2g 量程下 1g 的原始值，量程每扩大一倍减半
+
+struct jason_sh3001_sim {
+    spinlock_t lock;
+    uint8_t regs[256];
+    uint8_t ptr;                // 当前寄存器地址，读写后自动加一
+    bool ptr_written;           // 本次写传输已经收到寄存器地址
+    u32 frame;                  // 已产生的样本数
+    int irq_gpio;
+    struct hrtimer timer;
+};
+
+static const struct {
+    uint8_t odr;
+    int hz;
+} jason_sh3001_sim_odr[] = {
+    { ACC_ODR_16HZ, 16 }, { ACC_ODR_31HZ, 31 }, { ACC_ODR_63HZ, 63 },
+    { ACC_ODR_125HZ, 125 }, { ACC_ODR_250HZ, 250 }, { ACC_ODR_500HZ, 500 },
+    { ACC_ODR_1000HZ, 1000 }, { ACC_ODR_2000HZ, 2000 }, { ACC_ODR_4000HZ, 4000 },
+    { ACC_ODR_8000HZ, 8000 },
+};
+
+static ktime_t jason_sh3001_sim_period(struct jason_sh3001_sim *sim)
+{
+    uint8_t odr = sim->regs[ACC_CONFIG_1] & ACC_CONFIG_1_MASK;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(jason_sh3001_sim_odr); i++) {
+        if (jason_sh3001_sim_odr[i].odr == odr)
+            return ns_to_ktime(NSEC_PER_SEC / jason_sh3001_sim_odr[i].hz);
+    }
+
+    return ns_to_ktime(NSEC_PER_SEC / 500);
+}
+
+// 按驱动写入 ACC_CONFIG_2 的量程计算 1g 的原始值
+static int jason_sh3001_sim_one_g(struct jason_sh3001_sim *sim)
+{
+    switch (sim->regs[ACC_CONFIG_2] & ACC_CONFIG_2_MASK) {
+    case ACC_RANGE_16G:
+        return JASON_SH3001_SIM_ONE_G_2G >> 3;
+    case ACC_RANGE_8G:
+        return JASON_SH3001_SIM_ONE_G_2G >> 2;
+    case ACC_RANGE_4G:
+        return JASON_SH3001_SIM_ONE_G_2G >> 1;
+    default:
+        return JASON_SH3001_SIM_ONE_G_2G;
+    }
+}
+
+static void jason_sh3001_sim_put16(struct jason_sh3001_sim *sim, uint8_t addr, int value)
+{
+    sim->regs[addr] = value & 0xFF;
+    sim->regs[addr + 1] = (value >> 8) & 0xFF;
+}
+
+// 产生一个新样本：静止水平放置，加速度计 x 轴为样本计数的低 16 位，便于在用户态检查丢帧和重复
+static void jason_sh3001_sim_sample(struct jason_sh3001_sim *sim)
+{
+    sim->frame++;
+    jason_sh3001_sim_put16(sim, ACC_XDATA_L, (s16)sim->frame);
+    jason_sh3001_sim_put16(sim, ACC_XDATA_L + 2, 0);
+    jason_sh3001_sim_put16(sim, ACC_XDATA_L + 4, jason_sh3001_sim_one_g(sim));
+    jason_sh3001_sim_put16(sim, GYRO_XDATA_L, 0);
+    jason_sh3001_sim_put16(sim, GYRO_XDATA_L + 2, 0);
+    jason_sh3001_sim_put16(sim, GYRO_XDATA_L + 4, 0);
+    jason_sh3001_sim_put16(sim, TEMP_DATA_L, JASON_SH3001_SIM_ROOM_TEMP);
+    sim->regs[INTERRUPT_STATUS_1] |= INT1_ACC_DRDY;
+}
+
+// 读出当前寄存器，INTERRUPT_STATUS_1 读后清除数据就绪标志
+static u8 jason_sh3001_sim_read(struct jason_sh3001_sim *sim)
+{
+    u8 val = sim->regs[sim->ptr];
+
+    if (sim->ptr == INTERRUPT_STATUS_1)
+        sim->regs[INTERRUPT_STATUS_1] &= ~INT1_ACC_DRDY;
+
+    return val;
+}
+
+static enum hrtimer_restart jason_sh3001_sim_timer(struct hrtimer *timer)
+{
+    struct jason_sh3001_sim *sim = container_of(timer, struct jason_sh3001_sim, timer);
+    ktime_t period;
+
+    spin_lock(&sim->lock);
+    jason_sh3001_sim_sample(sim);
+    period = jason_sh3001_sim_period(sim);
+    spin_unlock(&sim->lock);
+
+    gpio_set_value(sim->irq_gpio, 1);
+    hrtimer_forward_now(timer, period);
+
+    return HRTIMER_RESTART;
+}
+
+static int jason_sh3001_sim_slave_cb(struct i2c_client *client,
+            enum i2c_slave_event event, u8 *val)
+{
+    struct jason_sh3001_sim *sim = i2c_get_clientdata(client);
+
+    spin_lock(&sim->lock);
+    switch (event) {
+    case I2C_SLAVE_WRITE_REQUESTED:
+        sim->ptr_written = false;
+        break;
+
+    case I2C_SLAVE_WRITE_RECEIVED:
+        if (!sim->ptr_written) {
+            sim->ptr = *val;
+            sim->ptr_written = true;
+        } else {
+            /* 数据寄存器只读，FIFO_RESET 写 1 清空 FIFO，不保存 */
+            if (sim->ptr == FIFO_CONFIG_0)
+                sim->regs[sim->ptr] = *val & ~FIFO_RESET;
+            else if (sim->ptr > TEMP_DATA_H)
+                sim->regs[sim->ptr] = *val;
+            sim->ptr++;
+        }
+        break;
+
+    case I2C_SLAVE_READ_REQUESTED:
+        if (sim->ptr == ACC_XDATA_L) {
+            if (gpio_is_valid(sim->irq_gpio))
+                gpio_set_value(sim->irq_gpio, 0);
+            else
+                jason_sh3001_sim_sample(sim);
+        }
+        *val = jason_sh3001_sim_read(sim);
+        break;
+
+    case I2C_SLAVE_READ_PROCESSED:
+        sim->ptr++;
+        *val = jason_sh3001_sim_read(sim);
+        break;
+
+    case I2C_SLAVE_STOP:
+    default:
+        break;
+    }
+    spin_unlock(&sim->lock);
+
+    return 0;
+}
+
+static int jason_sh3001_sim_probe(struct i2c_client *client, const struct i2c_device_id *id)
+{
+    struct jason_sh3001_sim *sim;
+    int ret;
+
+    sim = devm_kzalloc(&client->dev, sizeof(*sim), GFP_KERNEL);
+    if (!sim)
+        return -ENOMEM;
+
+    spin_lock_init(&sim->lock);
+    sim->irq_gpio = irq_gpio;
+    sim->regs[CHIP_ID] = JASON_SH3001_CHIP_ID;
+    sim->regs[TEMP_SENSOR_CONFIG_0] = (JASON_SH3001_SIM_ROOM_TEMP >> 8) & 0x0F;
+    sim->regs[TEMP_SENSOR_CONFIG_1] = JASON_SH3001_SIM_ROOM_TEMP & 0xFF;
+    sim->regs[ACC_CONFIG_1] = ACC_ODR_500HZ;
+    sim->regs[ACC_CONFIG_2] = ACC_RANGE_2G;
+    jason_sh3001_sim_sample(sim);
+    i2c_set_clientdata(client, sim);
+
+    if (gpio_is_valid(sim->irq_gpio)) {
+        ret = devm_gpio_request_one(&client->dev, sim->irq_gpio, GPIOF_OUT_INIT_LOW, "sh3001-sim-int");
+        if (ret)
+            return ret;
+        hrtimer_init(&sim->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+        sim->timer.function = jason_sh3001_sim_timer;
+    }
+
+    ret = i2c_slave_register(client, jason_sh3001_sim_slave_cb);
+    if (ret)
+        return ret;
+
+    if (gpio_is_valid(sim->irq_gpio))
+        hrtimer_start(&sim->timer, jason_sh3001_sim_period(sim), HRTIMER_MODE_REL);
+
+    dev_info(&client->dev, "simulated sh3001 at 0x%02x, %s\n", client->addr,
+        gpio_is_valid(sim->irq_gpio) ? "data ready on gpio" : "sample on read");
+
+    return 0;
+}
+
+static int jason_sh3001_sim_remove(struct i2c_client *client)
+{
+    struct jason_sh3001_sim *sim = i2c_get_clientdata(client);
+
+    i2c_slave_unregister(client);
+    if (gpio_is_valid(sim->irq_gpio))
+        hrtimer_cancel(&sim->timer);
+
+    return 0;
+}
+
+static const struct i2c_device_id jason_sh3001_sim_id[] = {
+    { "slave-sh3001", 0 },
+    { }
+};
+MODULE_DEVICE_TABLE(i2c, jason_sh3001_sim_id);
+
+static struct i2c_driver jason_sh3001_sim_driver = {
+    .driver = {
+        .name = "i2c-slave-sh3001",
+    },
+    .probe = jason_sh3001_sim_probe,
+    .remove = jason_sh3001_sim_remove,
+    .id_table = jason_sh3001_sim_id,
+};
+module_i2c_driver(jason_sh3001_sim_driver);
+
+MODULE_AUTHOR("Jason Jia");
+MODULE_DESCRIPTION("Simulated SH3001 i2c slave backend for benchmarks");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,50 @@
+#include <linux/kernel.h>
+#include <linux/i2c.h>
+#include <linux/input.h>
+#include <linux/types.h>
+#include <linux/interrupt.h>
+#include "jason_sh3001.h"
+
+/**********************************Specific**************************************/
+
+// 上报单位为 0.001°C
+void jason_sh3001_temp_report(struct sensor_private_data *sensor,
+            const uint8_t *buf, ktime_t timestamp)
+{
+    struct jason_sh3001_data *data = sensor->private_data;
+    struct sensor_axis axis;
+
+    axis.x = jason_sh3001_temp_mdeg(data, buf);
+    axis.y = 0;
+    axis.z = 0;
+
+    input_report_abs(sensor->input_dev, ABS_THROTTLE, axis.x);
+    jason_sensor_input_sync(sensor, timestamp);
+
+    jason_sensor_publish(sensor, &axis, timestamp);
+}
+
+/**********************************General**************************************/
+
+/* 温度传感器是从设备，数据由核心读取后通过 jason_sh3001_temp_report 分发过来 */
+struct sensor_operate jason_sh3001_temp_ops = {
+    .name = "jason_sh3001_temp",
+    .type = SENSOR_TYPE_TEMPERATURE,
+    .id_i2c = TEMPERATURE_ID_ALL,
+    .read_reg = TEMP_DATA_L,
+    .read_len = 2,
+    .id_reg = CHIP_ID,
+    .id_data = JASON_SH3001_CHIP_ID,
+    .precision = 12,
+    .ctrl_reg = -1,
+    .ctrl_data = -1,
+    .int_ctrl_reg = -1,
+    .int_status_reg = -1,
+    .range = {-40000, 85000},
+    .trig = IRQF_TRIGGER_HIGH | IRQF_ONESHOT,
+    .init = NULL,
+    .active = NULL,
+    .report = NULL,
+    .suspend = NULL,
+    .resume = NULL,
+};
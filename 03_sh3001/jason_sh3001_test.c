@@ -1,192 +1,267 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
 #include <errno.h>
 #include <string.h>
+#include <poll.h>
+#include <dirent.h>
+#include <limits.h>
+#include "libjason_sensor.h"
 
-#define SENSOR_ACCEL_IOCTL_MAGIC			'a'
-#define GBUFF_SIZE				12	/* Rx buffer size */
-
-/* IOCTLs for sensir accell library */
-#define SENSOR_ACCEL_IOCTL_CLOSE					_IO(SENSOR_ACCEL_IOCTL_MAGIC, 0x02)
-#define SENSOR_ACCEL_IOCTL_START					_IO(SENSOR_ACCEL_IOCTL_MAGIC, 0x03)
-#define SENSOR_ACCEL_IOCTL_GETDATA					_IOR(SENSOR_ACCEL_IOCTL_MAGIC, 0x08, char[GBUFF_SIZE+1])
-#define SENSOR_ACCEL_IOCTL_SET_RATE			_IOW(SENSOR_ACCEL_IOCTL_MAGIC, 0x10, short)
-
-
-#define SENSOR_GYRO_IOCTL_MAGIC			'g'
-#define GBUFF_SIZE				12	/* Rx buffer size */
+#define TEST_SAMPLES 10
+#define DEFAULT_PERIOD_US 30000 // 30ms
 
-/* IOCTLs for sensor accel library */
-#define SENSOR_GYRO_IOCTL_CLOSE					_IO(SENSOR_GYRO_IOCTL_MAGIC, 0x02)
-#define SENSOR_GYRO_IOCTL_START					_IO(SENSOR_GYRO_IOCTL_MAGIC, 0x03)
-#define SENSOR_GYRO_IOCTL_GETDATA					_IOR(SENSOR_GYRO_IOCTL_MAGIC, 0x08, char[GBUFF_SIZE+1])
-#define SENSOR_GYRO_IOCTL_SET_RATE			        _IOW(SENSOR_GYRO_IOCTL_MAGIC, 0x10, short)
+#define SAMPLE_BATCH 32
+#define MAX_SENSORS 8
 
-#define ACCEL_DEVICE "/dev/sensor_accel"
-#define GYRO_DEVICE "/dev/sensor_gyro"
-#define TEST_SAMPLES 10
-#define DEFAULT_RATE 30 // ms
+/* 通过 regmap 的 debugfs 检查芯片配置，寄存器地址见 jason_sh3001.h */
+#define REGMAP_DEBUGFS "/sys/kernel/debug/regmap"
+#define SH3001_ACC_CONFIG_1 0x23
+#define SH3001_GYRO_CONFIG_1 0x29
+#define SH3001_ODR_MASK 0x0F
 
-struct sensor_axis {
-    int x;
-    int y;
-    int z;
+static const char *path_name[] = {
+    [JSENSOR_PATH_MMAP] = "mmap",
+    [JSENSOR_PATH_BATCH] = "batch ioctl",
+    [JSENSOR_PATH_READ] = "read",
 };
 
-int read_sensor(int fd, const char *sensor_name, int is_gyro);
-int start_sensor(int fd, const char *sensor_name, int is_gyro);
-int close_sensor(int fd, const char *sensor_name, int is_gyro);
+static void print_samples(const char *sensor_name, const struct sensor_sample *samples, int count)
+{
+    int i;
 
-void print_axis_data(const char *sensor_name, struct sensor_axis *axis) {
-    printf("%s Data: X=%d, Y=%d, Z=%d\n", sensor_name, axis->x, axis->y, axis->z);
+    for (i = 0; i < count; i++) {
+        if (samples[i].flags & SENSOR_SAMPLE_FLAG_OVERRUN)
+            printf("%s: samples lost before seq %u\n", sensor_name, samples[i].seq);
+        printf("%s [%u @ %lld ns]: X=%d, Y=%d, Z=%d\n", sensor_name, samples[i].seq,
+            samples[i].timestamp, samples[i].axis.x, samples[i].axis.y, samples[i].axis.z);
+    }
 }
 
-int test_sensor(int fd, const char *sensor_name, int is_gyro) {
-    int ret;
-    struct sensor_axis axis;
-    int calibration[3];
-    short rate = DEFAULT_RATE;
-    int enable = 1;
-    int i;
+// 设置周期、打开传感器，阻塞读取 TEST_SAMPLES 个样本后关闭
+static int test_sensor(struct jsensor *s, const char *sensor_name)
+{
+    struct sensor_sample samples[TEST_SAMPLES];
+    int ret, got = 0;
 
-    // Set sampling rate
-    printf("Setting %s rate to %dms\n", sensor_name, rate);
-    ret = ioctl(fd, is_gyro ? SENSOR_GYRO_IOCTL_SET_RATE : SENSOR_ACCEL_IOCTL_SET_RATE, &rate);
-    if (ret < 0) {
-        perror("Failed to set rate");
+    printf("Setting %s period to %dus\n", sensor_name, DEFAULT_PERIOD_US);
+    ret = jsensor_set_period_us(s, DEFAULT_PERIOD_US);
+    if (ret < 0 && ret != -ENOTTY) {
+        printf("Failed to set period: %s\n", strerror(-ret));
         return -1;
     }
 
-    // Enable sensor
-    printf("Enabling %s\n", sensor_name);
-    ret = ioctl(fd, is_gyro ? SENSOR_GYRO_IOCTL_START : SENSOR_ACCEL_IOCTL_START, &enable);
+    printf("Enabling %s (reading via %s)\n", sensor_name, path_name[jsensor_path(s)]);
+    ret = jsensor_start(s);
     if (ret < 0) {
-        perror("Failed to enable sensor");
+        printf("Failed to enable sensor: %s\n", strerror(-ret));
         return -1;
     }
 
-    // Read sensor data
     printf("Reading %s data (%d samples)...\n", sensor_name, TEST_SAMPLES);
-    for (i = 0; i < TEST_SAMPLES; i++) {
-        ret = ioctl(fd, is_gyro ? SENSOR_GYRO_IOCTL_GETDATA : SENSOR_ACCEL_IOCTL_GETDATA, &axis);
-        if (ret < 0) {
-            perror("Failed to read sensor data");
+    while (got < TEST_SAMPLES) {
+        ret = jsensor_read(s, samples, TEST_SAMPLES - got, 1000);
+        if (ret <= 0) {
+            printf("Failed to read sensor data: %s\n", ret ? strerror(-ret) : "timeout");
+            jsensor_stop(s);
             return -1;
         }
-        print_axis_data(sensor_name, &axis);
-        usleep(rate * 1000);
+        print_samples(sensor_name, samples, ret);
+        got += ret;
     }
 
-    // Disable sensor
-    enable = 0;
     printf("Disabling %s\n", sensor_name);
-    ret = ioctl(fd, is_gyro ? SENSOR_GYRO_IOCTL_CLOSE : SENSOR_ACCEL_IOCTL_CLOSE, &enable);
+    ret = jsensor_stop(s);
     if (ret < 0) {
-        perror("Failed to disable sensor");
+        printf("Failed to disable sensor: %s\n", strerror(-ret));
         return -1;
     }
 
     return 0;
 }
 
-int start_sensor(int fd, const char *sensor_name, int is_gyro) {
-    int ret;
-    int enable = 1;
-
-    // Enable sensor
-    printf("Enabling %s\n", sensor_name);
-    ret = ioctl(fd, is_gyro ? SENSOR_GYRO_IOCTL_START : SENSOR_ACCEL_IOCTL_START, &enable);
-    if (ret < 0) {
-        perror("Failed to enable sensor");
+// 在 regmap 的 debugfs 中找到 SH3001 的寄存器文件
+static int find_sh3001_regs(char *path, size_t size)
+{
+    struct dirent *entry;
+    char name[64];
+    DIR *dir;
+    FILE *fp;
+    int ret = -1;
+
+    dir = opendir(REGMAP_DEBUGFS);
+    if (!dir)
         return -1;
+
+    while (ret < 0 && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf(path, size, "%s/%s/name", REGMAP_DEBUGFS, entry->d_name);
+        fp = fopen(path, "r");
+        if (!fp)
+            continue;
+        if (fgets(name, sizeof(name), fp) && !strncmp(name, "jason_sh3001", 12)) {
+            snprintf(path, size, "%s/%s/registers", REGMAP_DEBUGFS, entry->d_name);
+            ret = 0;
+        }
+        fclose(fp);
     }
+    closedir(dir);
 
-    return 0;
+    return ret;
 }
 
-int close_sensor(int fd, const char *sensor_name, int is_gyro) {
-    int ret;
-    int enable = 1;
+// 读 registers 文件中的一个寄存器（每行 "地址: 值"），失败返回 -1
+static int read_sh3001_reg(const char *path, unsigned int reg)
+{
+    unsigned int addr, val;
+    char line[64];
+    FILE *fp;
+    int ret = -1;
 
-    // Disable sensor
-    enable = 0;
-    printf("Disabling %s\n", sensor_name);
-    ret = ioctl(fd, is_gyro ? SENSOR_GYRO_IOCTL_CLOSE : SENSOR_ACCEL_IOCTL_CLOSE, &enable);
-    if (ret < 0) {
-        perror("Failed to disable sensor");
+    fp = fopen(path, "r");
+    if (!fp)
         return -1;
+    while (ret < 0 && fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%x: %x", &addr, &val) == 2 && addr == reg)
+            ret = val;
     }
+    fclose(fp);
 
-    return 0;
+    return ret;
 }
 
-int read_sensor(int fd, const char *sensor_name, int is_gyro) {
-    int ret;
-    struct sensor_axis axis;
+/*
+ * 加速度计和陀螺仪的 ODR 相互独立：修改加速度计的周期后 ACC_CONFIG_1 的 ODR 随之改变，GYRO_CONFIG_1 不变。
+ * 只适用于 bypass 轮询模式，FIFO 和数据就绪中断模式下两者使用同一个 ODR。
+ */
+static int test_independent_rate(struct jsensor *accel, struct jsensor *gyro)
+{
+    char regs[PATH_MAX];
+    int acc_before, gyro_before, acc_after, gyro_after;
+
+    if (find_sh3001_regs(regs, sizeof(regs)) < 0) {
+        printf("SH3001 registers not found under %s, is debugfs mounted?\n", REGMAP_DEBUGFS);
+        return -1;
+    }
 
-    // Read sensor data
-    ret = ioctl(fd, is_gyro ? SENSOR_GYRO_IOCTL_GETDATA : SENSOR_ACCEL_IOCTL_GETDATA, &axis);
-    if (ret < 0) {
-        perror("Failed to read sensor data");
+    jsensor_start(accel);
+    jsensor_start(gyro);
+    jsensor_set_period_us(gyro, 20000);
+    jsensor_set_period_us(accel, 20000);
+    acc_before = read_sh3001_reg(regs, SH3001_ACC_CONFIG_1);
+    gyro_before = read_sh3001_reg(regs, SH3001_GYRO_CONFIG_1);
+
+    jsensor_set_period_us(accel, 2000);
+    acc_after = read_sh3001_reg(regs, SH3001_ACC_CONFIG_1);
+    gyro_after = read_sh3001_reg(regs, SH3001_GYRO_CONFIG_1);
+    jsensor_stop(gyro);
+    jsensor_stop(accel);
+
+    if (acc_before < 0 || gyro_before < 0 || acc_after < 0 || gyro_after < 0) {
+        printf("Failed to read %s\n", regs);
+        return -1;
+    }
+    acc_before &= SH3001_ODR_MASK;
+    acc_after &= SH3001_ODR_MASK;
+    gyro_before &= SH3001_ODR_MASK;
+    gyro_after &= SH3001_ODR_MASK;
+    printf("Accelerometer period 20ms -> 2ms: ACC_CONFIG_1 odr 0x%x -> 0x%x, GYRO_CONFIG_1 odr 0x%x -> 0x%x\n",
+        acc_before, acc_after, gyro_before, gyro_after);
+
+    if (acc_after == acc_before) {
+        printf("Accelerometer ODR did not follow its period\n");
+        return -1;
+    }
+    if (gyro_after != gyro_before) {
+        printf("Gyroscope ODR changed with the accelerometer period\n");
         return -1;
     }
-    print_axis_data(sensor_name, &axis);
 
     return 0;
 }
 
-int main(int argc, char *argv[]) {
-    int accel_fd, gyro_fd;
+int main(void)
+{
+    struct jsensor_info info[MAX_SENSORS];
+    struct jsensor *accel, *gyro;
+    struct sensor_sample samples[SAMPLE_BATCH];
+    int count, i, n;
 
-    // Open accelerometer device
-    accel_fd = open(ACCEL_DEVICE, O_RDWR);
-    if (accel_fd < 0) {
+    count = jsensor_discover(info, MAX_SENSORS);
+    if (count < 0) {
+        printf("Failed to list sensors: %s\n", strerror(-count));
+        return -1;
+    }
+    for (i = 0; i < count && i < MAX_SENSORS; i++)
+        printf("Found %s #%d: %s\n", jsensor_type_name(info[i].type), info[i].index, info[i].path);
+
+    accel = jsensor_open(JSENSOR_ACCEL, NULL);
+    if (!accel) {
         perror("Failed to open accelerometer device");
         return -1;
     }
 
-    // Open gyroscope device
-    gyro_fd = open(GYRO_DEVICE, O_RDWR);
-    if (gyro_fd < 0) {
+    gyro = jsensor_open(JSENSOR_GYRO, NULL);
+    if (!gyro) {
         perror("Failed to open gyroscope device");
-        close(accel_fd);
+        jsensor_close(accel);
         return -1;
     }
 
-    // Test accelerometer
     printf("\n=== Testing Accelerometer ===\n");
-    if (test_sensor(accel_fd, "Accelerometer", 0) < 0) {
+    if (test_sensor(accel, "Accelerometer") < 0) {
         printf("Accelerometer test failed\n");
     } else {
         printf("Accelerometer test completed successfully\n");
     }
 
-    // Test gyroscope
     printf("\n=== Testing Gyroscope ===\n");
-    if (test_sensor(gyro_fd, "Gyroscope", 1) < 0) {
+    if (test_sensor(gyro, "Gyroscope") < 0) {
         printf("Gyroscope test failed\n");
     } else {
         printf("Gyroscope test completed successfully\n");
     }
 
-    start_sensor(accel_fd, "Accelerometer", 0);
-    start_sensor(gyro_fd, "Gyroscope", 1);
-    
-    while(1){
-        read_sensor(accel_fd, "Accelerometer", 0);
-        read_sensor(gyro_fd, "Gyroscope", 1);
-        usleep(1000 * 100); // 睡眠 100 毫秒
+    printf("\n=== Testing independent accel/gyro ODR ===\n");
+    if (test_independent_rate(accel, gyro) < 0) {
+        printf("Independent ODR test failed\n");
+    } else {
+        printf("Independent ODR test completed successfully\n");
     }
 
+    jsensor_start(accel);
+    jsensor_start(gyro);
+
+    // 事件循环：可读时取完样本，回到 poll 之前 arm，mmap 读取时不需要系统调用取数据
+    while (1) {
+        struct pollfd fds[2] = {
+            { .fd = jsensor_fd(accel), .events = POLLIN },
+            { .fd = jsensor_fd(gyro), .events = POLLIN },
+        };
+
+        if (jsensor_arm(accel) > 0 || jsensor_arm(gyro) > 0) {
+            fds[0].revents = fds[1].revents = POLLIN;
+        } else if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            while ((n = jsensor_drain(accel, samples, SAMPLE_BATCH)) > 0)
+                print_samples("Accelerometer", samples, n);
+        }
+        if (fds[1].revents & POLLIN) {
+            while ((n = jsensor_drain(gyro, samples, SAMPLE_BATCH)) > 0)
+                print_samples("Gyroscope", samples, n);
+        }
+    }
 
-    close_sensor(accel_fd, "Accelerometer", 0);
-    close_sensor(gyro_fd, "Gyroscope", 1);
+    jsensor_stop(accel);
+    jsensor_stop(gyro);
 
-    // Clean up
-    close(accel_fd);
-    close(gyro_fd);
+    jsensor_close(accel);
+    jsensor_close(gyro);
     return 0;
-}
\ No newline at end of file
+}
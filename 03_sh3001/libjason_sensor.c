@@ -0,0 +1,451 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "libjason_sensor.h"
+
+/* 各类型传感器的设备名和 ioctl，0 表示驱动不支持 */
+struct jsensor_desc {
+    const char *name;
+    unsigned long start;
+    unsigned long stop;
+    unsigned long set_period;
+    unsigned long get_batch;
+};
+
+static const struct jsensor_desc jsensor_desc[JSENSOR_TYPE_NUM] = {
+    [JSENSOR_ACCEL] = {
+        "sensor_accel", SENSOR_ACCEL_IOCTL_START, SENSOR_ACCEL_IOCTL_CLOSE,
+        SENSOR_ACCEL_IOCTL_SET_PERIOD_US, SENSOR_ACCEL_IOCTL_GET_BATCH,
+    },
+    [JSENSOR_GYRO] = {
+        "sensor_gyro", SENSOR_GYRO_IOCTL_START, SENSOR_GYRO_IOCTL_CLOSE,
+        SENSOR_GYRO_IOCTL_SET_PERIOD_US, SENSOR_GYRO_IOCTL_GET_BATCH,
+    },
+    /* 温度传感器用 TEMPERATURE_IOCTL_ENABLE 打开和关闭，见 jsensor_enable */
+    [JSENSOR_TEMPERATURE] = {
+        "temperature", 0, 0, 0, 0,
+    },
+    [JSENSOR_ANGLE] = {
+        "sensor_angle", SENSOR_ANGLE_IOCTL_START, SENSOR_ANGLE_IOCTL_CLOSE,
+        SENSOR_ANGLE_IOCTL_SET_PERIOD_US, SENSOR_ANGLE_IOCTL_GET_BATCH,
+    },
+};
+
+struct jsensor {
+    int fd;
+    enum jsensor_type type;
+    enum jsensor_path path;
+    /* mmap 读取 */
+    const struct sensor_ring_header *hdr;
+    const struct sensor_sample *ring;
+    size_t map_size;
+    unsigned int mask;
+    unsigned int seq;           /* 下一个要读取的样本序号 */
+    /* 批量读取 */
+    unsigned int batch_count;
+    long long batch_latency_ns;
+    unsigned long long dropped;
+};
+
+const char *jsensor_type_name(enum jsensor_type type)
+{
+    if (type < 0 || type >= JSENSOR_TYPE_NUM)
+        return "unknown";
+
+    return jsensor_desc[type].name;
+}
+
+// 设备名为 name 或 name 后跟实例编号，返回编号，不匹配返回 -1
+static int jsensor_match(const char *entry, const char *name)
+{
+    size_t len = strlen(name);
+    const char *p;
+    int index = 0;
+
+    if (strncmp(entry, name, len))
+        return -1;
+    if (entry[len] == '\0')
+        return 0;
+
+    for (p = entry + len; *p; p++) {
+        if (*p < '0' || *p > '9')
+            return -1;
+        index = index * 10 + (*p - '0');
+    }
+
+    return index;
+}
+
+int jsensor_discover(struct jsensor_info *info, int max)
+{
+    struct dirent *entry;
+    DIR *dir;
+    int type, index, count = 0;
+
+    dir = opendir("/dev");
+    if (!dir)
+        return -errno;
+
+    while ((entry = readdir(dir)) != NULL) {
+        for (type = 0; type < JSENSOR_TYPE_NUM; type++) {
+            index = jsensor_match(entry->d_name, jsensor_desc[type].name);
+            if (index < 0)
+                continue;
+            if (count < max) {
+                info[count].type = type;
+                info[count].index = index;
+                snprintf(info[count].path, sizeof(info[count].path), "/dev/%.58s", entry->d_name);
+            }
+            count++;
+            break;
+        }
+    }
+    closedir(dir);
+
+    return count;
+}
+
+/*
+ * 映射样本环。驱动不支持 mmap、布局版本不认识，或者不支持用 lseek 同步读取位置时
+ * 返回 -1，改用 ioctl 或 read() 读取。
+ */
+static int jsensor_map(struct jsensor *s)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    const struct sensor_ring_header *hdr;
+    unsigned int capacity, offset;
+    void *map;
+
+    hdr = mmap(NULL, page, PROT_READ, MAP_SHARED, s->fd, 0);
+    if (hdr == MAP_FAILED)
+        return -1;
+
+    if (hdr->magic != SENSOR_RING_MAGIC || hdr->version != SENSOR_RING_VERSION ||
+        hdr->format != SENSOR_SAMPLE_FMT_AXIS || hdr->sample_size != sizeof(struct sensor_sample) ||
+        !hdr->capacity || (hdr->capacity & (hdr->capacity - 1))) {
+        munmap((void *)hdr, page);
+        return -1;
+    }
+    capacity = hdr->capacity;
+    offset = hdr->data_offset;
+    munmap((void *)hdr, page);
+
+    s->map_size = offset + (size_t)capacity * sizeof(struct sensor_sample);
+    map = mmap(NULL, s->map_size, PROT_READ, MAP_SHARED, s->fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+
+    s->hdr = map;
+    s->ring = (const struct sensor_sample *)((const char *)map + offset);
+    s->mask = capacity - 1;
+    s->seq = __atomic_load_n(&s->hdr->write_seq, __ATOMIC_ACQUIRE);
+
+    if (lseek(s->fd, s->seq, SEEK_SET) < 0) {
+        munmap(map, s->map_size);
+        s->hdr = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+struct jsensor *jsensor_open(enum jsensor_type type, const char *path)
+{
+    struct sensor_batch batch;
+    struct jsensor *s;
+    char dev[64];
+    int err;
+
+    if (type < 0 || type >= JSENSOR_TYPE_NUM) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (!path) {
+        snprintf(dev, sizeof(dev), "/dev/%s", jsensor_desc[type].name);
+        path = dev;
+    }
+
+    s = calloc(1, sizeof(*s));
+    if (!s)
+        return NULL;
+    s->type = type;
+
+    s->fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (s->fd < 0) {
+        err = errno;
+        free(s);
+        errno = err;
+        return NULL;
+    }
+
+    /* 按 mmap、GET_BATCH、read() 的顺序选择读取路径 */
+    memset(&batch, 0, sizeof(batch));
+    if (jsensor_map(s) == 0)
+        s->path = JSENSOR_PATH_MMAP;
+    else if (jsensor_desc[type].get_batch && ioctl(s->fd, jsensor_desc[type].get_batch, &batch) == 0)
+        s->path = JSENSOR_PATH_BATCH;
+    else
+        s->path = JSENSOR_PATH_READ;
+
+    return s;
+}
+
+void jsensor_close(struct jsensor *s)
+{
+    if (!s)
+        return;
+
+    if (s->hdr)
+        munmap((void *)s->hdr, s->map_size);
+    close(s->fd);
+    free(s);
+}
+
+static int jsensor_enable(struct jsensor *s, int enable)
+{
+    const struct jsensor_desc *desc = &jsensor_desc[s->type];
+    int ret;
+
+    if (s->type == JSENSOR_TEMPERATURE)
+        ret = ioctl(s->fd, TEMPERATURE_IOCTL_ENABLE, &enable);
+    else
+        ret = ioctl(s->fd, enable ? desc->start : desc->stop);
+
+    return ret < 0 ? -errno : 0;
+}
+
+int jsensor_start(struct jsensor *s)
+{
+    return jsensor_enable(s, 1);
+}
+
+int jsensor_stop(struct jsensor *s)
+{
+    return jsensor_enable(s, 0);
+}
+
+int jsensor_set_period_us(struct jsensor *s, unsigned int period_us)
+{
+    if (!jsensor_desc[s->type].set_period)
+        return -ENOTTY;
+    if (ioctl(s->fd, jsensor_desc[s->type].set_period, &period_us) < 0)
+        return -errno;
+
+    return 0;
+}
+
+int jsensor_set_batch(struct jsensor *s, unsigned int count, unsigned int max_latency_us)
+{
+    s->batch_count = count;
+    s->batch_latency_ns = (long long)max_latency_us * 1000;
+
+    return 0;
+}
+
+enum jsensor_path jsensor_path(const struct jsensor *s)
+{
+    return s->path;
+}
+
+int jsensor_set_path(struct jsensor *s, enum jsensor_path path)
+{
+    struct sensor_batch batch;
+    off_t pos;
+
+    switch (path) {
+    case JSENSOR_PATH_MMAP:
+        if (!s->hdr)
+            return -ENOTSUP;
+        break;
+    case JSENSOR_PATH_BATCH:
+        memset(&batch, 0, sizeof(batch));
+        if (!jsensor_desc[s->type].get_batch || ioctl(s->fd, jsensor_desc[s->type].get_batch, &batch) < 0)
+            return -ENOTSUP;
+        break;
+    case JSENSOR_PATH_READ:
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    /* mmap 读取时已读位置在 s->seq，其他路径在驱动的文件位置，切换时接上 */
+    if (s->path == JSENSOR_PATH_MMAP && path != JSENSOR_PATH_MMAP) {
+        if (lseek(s->fd, s->seq, SEEK_SET) < 0)
+            return -errno;
+    } else if (s->path != JSENSOR_PATH_MMAP && path == JSENSOR_PATH_MMAP) {
+        pos = lseek(s->fd, 0, SEEK_CUR);
+        if (pos < 0)
+            return -errno;
+        s->seq = pos;
+    }
+    s->path = path;
+
+    return 0;
+}
+
+int jsensor_fd(const struct jsensor *s)
+{
+    return s->fd;
+}
+
+unsigned long long jsensor_dropped(const struct jsensor *s)
+{
+    return s->dropped;
+}
+
+/* 从映射的样本环取出一个样本，协议见 struct sensor_ring_header，与驱动中的 sensor_ring_pop 相同 */
+static int jsensor_ring_pop(struct jsensor *s, struct sensor_sample *sample)
+{
+    const struct sensor_sample *slot;
+    unsigned int head, lost = 0;
+
+    for (;;) {
+        head = __atomic_load_n(&s->hdr->write_seq, __ATOMIC_ACQUIRE);
+        if (s->seq == head)
+            return 0;
+
+        if (head - s->seq > s->mask + 1) {
+            lost += head - (s->mask + 1) - s->seq;
+            s->seq = head - (s->mask + 1);
+        }
+
+        slot = &s->ring[s->seq & s->mask];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != s->seq)
+            goto overwritten;
+        memcpy(sample, slot, sizeof(*sample));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == s->seq)
+            break;
+overwritten:
+        /* 内核已经绕回来覆盖了这个槽位，从当前最旧的样本重新开始 */
+        lost++;
+        s->seq++;
+    }
+
+    s->seq++;
+    if (lost) {
+        sample->flags |= SENSOR_SAMPLE_FLAG_OVERRUN;
+        s->dropped += lost;
+    }
+
+    return 1;
+}
+
+int jsensor_drain(struct jsensor *s, struct sensor_sample *samples, unsigned int max)
+{
+    struct sensor_batch batch;
+    unsigned int n = 0;
+    ssize_t len;
+
+    switch (s->path) {
+    case JSENSOR_PATH_MMAP:
+        while (n < max && jsensor_ring_pop(s, &samples[n]))
+            n++;
+        return n;
+
+    case JSENSOR_PATH_BATCH:
+        memset(&batch, 0, sizeof(batch));
+        batch.samples = (unsigned long long)(unsigned long)samples;
+        batch.max = max;
+        if (ioctl(s->fd, jsensor_desc[s->type].get_batch, &batch) < 0)
+            return errno == EAGAIN ? 0 : -errno;
+        s->dropped += batch.dropped;
+        return batch.count;
+
+    case JSENSOR_PATH_READ:
+    default:
+        if (!max)
+            return 0;
+        len = read(s->fd, samples, max * sizeof(*samples));
+        if (len < 0)
+            return errno == EAGAIN ? 0 : -errno;
+        n = len / sizeof(*samples);
+        /* read() 不返回丢失的个数，只能按被标记的样本计数 */
+        for (max = 0; max < n; max++) {
+            if (samples[max].flags & SENSOR_SAMPLE_FLAG_OVERRUN)
+                s->dropped++;
+        }
+        return n;
+    }
+}
+
+int jsensor_arm(struct jsensor *s)
+{
+    if (s->path != JSENSOR_PATH_MMAP)
+        return 0;
+
+    if (lseek(s->fd, s->seq, SEEK_SET) < 0)
+        return -errno;
+
+    return __atomic_load_n(&s->hdr->write_seq, __ATOMIC_ACQUIRE) != s->seq;
+}
+
+// 样本的时间戳为 CLOCK_BOOTTIME，超时和批量延时也按它计算
+static long long jsensor_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int jsensor_read(struct jsensor *s, struct sensor_sample *samples, unsigned int max, int timeout_ms)
+{
+    struct pollfd pfd = { .fd = s->fd, .events = POLLIN };
+    long long deadline = -1, wait_ns, now;
+    unsigned int want, n = 0;
+    int ret;
+
+    if (!max)
+        return 0;
+
+    want = s->batch_count > 1 ? s->batch_count : 1;
+    if (want > max)
+        want = max;
+    if (timeout_ms >= 0)
+        deadline = jsensor_now_ns() + timeout_ms * 1000000LL;
+
+    for (;;) {
+        ret = jsensor_drain(s, samples + n, max - n);
+        if (ret < 0)
+            return n ? (int)n : ret;
+        n += ret;
+        if (n >= want)
+            return n;
+
+        /* 攒批量时，第一个样本采集后最多再等 batch_latency_ns */
+        now = jsensor_now_ns();
+        wait_ns = deadline < 0 ? LLONG_MAX : deadline - now;
+        if (n && s->batch_latency_ns && samples[0].timestamp + s->batch_latency_ns - now < wait_ns)
+            wait_ns = samples[0].timestamp + s->batch_latency_ns - now;
+        if (wait_ns <= 0)
+            return n;
+
+        ret = jsensor_arm(s);
+        if (ret < 0)
+            return n ? (int)n : ret;
+        if (ret)
+            continue;
+
+        if (wait_ns == LLONG_MAX)
+            ret = poll(&pfd, 1, -1);
+        else
+            ret = poll(&pfd, 1, (int)((wait_ns + 999999) / 1000000));
+        if (ret < 0)
+            return n ? (int)n : -errno;
+    }
+}
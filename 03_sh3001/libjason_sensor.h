@@ -0,0 +1,123 @@
+#ifndef __LIBJASON_SENSOR_H__
+#define __LIBJASON_SENSOR_H__
+
+/*
+ * 传感器 misc 设备的用户态客户端库。
+ *
+ * 打开传感器时按驱动支持的方式选择最快的读取路径：
+ *   1. mmap 样本环，有样本时不需要系统调用
+ *   2. *_IOCTL_GET_BATCH，一次系统调用取多个样本
+ *   3. read()
+ * 读样本时只拷贝到调用者提供的数组，不分配内存。
+ *
+ * 两种用法：
+ *   - 阻塞：jsensor_read() 等到至少有一个样本或超时
+ *   - 事件循环：把 jsensor_fd() 加入 poll/epoll（POLLIN），可读时调用 jsensor_drain() 取完样本，
+ *     取完后调用 jsensor_arm() 再回到事件循环，mmap 读取时 fd 的可读状态才与已读的位置一致
+ */
+
+#include <stddef.h>
+#include "jason_sensor_uapi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum jsensor_type {
+    JSENSOR_ACCEL = 0,
+    JSENSOR_GYRO,
+    JSENSOR_TEMPERATURE,
+    JSENSOR_ANGLE,
+    JSENSOR_TYPE_NUM,
+};
+
+enum jsensor_path {
+    JSENSOR_PATH_MMAP = 0,
+    JSENSOR_PATH_BATCH,
+    JSENSOR_PATH_READ,
+};
+
+/* jsensor_discover 找到的传感器 */
+struct jsensor_info {
+    enum jsensor_type type;
+    int index;              /* 同类型的第几个实例，对应设备名后的编号 */
+    char path[64];          /* 例如 /dev/sensor_accel、/dev/sensor_accel1 */
+};
+
+struct jsensor;
+
+/* 列出 /dev 下的传感器，最多填 max 个，返回找到的总数（可能大于 max），失败返回 -errno */
+int jsensor_discover(struct jsensor_info *info, int max);
+
+/* 打开传感器，path 为 NULL 时打开该类型的第一个实例；失败返回 NULL 并设置 errno */
+struct jsensor *jsensor_open(enum jsensor_type type, const char *path);
+void jsensor_close(struct jsensor *s);
+
+int jsensor_start(struct jsensor *s);
+int jsensor_stop(struct jsensor *s);
+
+/* 设置上报周期，驱动不支持时返回 -ENOTTY（温度传感器） */
+int jsensor_set_period_us(struct jsensor *s, unsigned int period_us);
+
+/*
+ * 批量读取：阻塞读取时至少攒够 count 个样本，或者等够 max_latency_us 才返回，减少唤醒次数。
+ * count 为 0 或 1 时有样本就返回。芯片 FIFO 的水位线仍由设备树配置。
+ */
+int jsensor_set_batch(struct jsensor *s, unsigned int count, unsigned int max_latency_us);
+
+/* 当前使用的读取路径 */
+enum jsensor_path jsensor_path(const struct jsensor *s);
+
+/* 指定读取路径，用于对比测试；驱动不支持该路径时返回 -ENOTSUP */
+int jsensor_set_path(struct jsensor *s, enum jsensor_path path);
+
+/* 非阻塞取出最多 max 个样本，返回个数，没有样本时返回 0，失败返回 -errno */
+int jsensor_drain(struct jsensor *s, struct sensor_sample *samples, unsigned int max);
+
+/*
+ * 阻塞读取最多 max 个样本，timeout_ms 为 -1 时一直等待。
+ * 返回样本个数，超时返回 0，被信号打断返回 -EINTR，失败返回 -errno。
+ */
+int jsensor_read(struct jsensor *s, struct sensor_sample *samples, unsigned int max, int timeout_ms);
+
+/* 事件循环用的 fd，只用于 poll/epoll，不要直接 read */
+int jsensor_fd(const struct jsensor *s);
+
+/* 回到事件循环之前调用：把已读的位置同步给驱动，返回 1 表示已经有新样本，不必等待 */
+int jsensor_arm(struct jsensor *s);
+
+/* 打开以来因读取过慢丢失的样本数 */
+unsigned long long jsensor_dropped(const struct jsensor *s);
+
+const char *jsensor_type_name(enum jsensor_type type);
+
+#ifdef __cplusplus
+}
+
+/* C++ 封装，析构时关闭传感器 */
+class JasonSensor {
+public:
+    explicit JasonSensor(enum jsensor_type type, const char *path = NULL)
+        : s_(jsensor_open(type, path)) {}
+    ~JasonSensor() { if (s_) jsensor_close(s_); }
+    JasonSensor(const JasonSensor &) = delete;
+    JasonSensor &operator=(const JasonSensor &) = delete;
+
+    bool ok() const { return s_ != NULL; }
+    int start() { return jsensor_start(s_); }
+    int stop() { return jsensor_stop(s_); }
+    int setPeriodUs(unsigned int period_us) { return jsensor_set_period_us(s_, period_us); }
+    int setBatch(unsigned int count, unsigned int max_latency_us) { return jsensor_set_batch(s_, count, max_latency_us); }
+    int setPath(enum jsensor_path path) { return jsensor_set_path(s_, path); }
+    int drain(struct sensor_sample *samples, unsigned int max) { return jsensor_drain(s_, samples, max); }
+    int read(struct sensor_sample *samples, unsigned int max, int timeout_ms = -1) { return jsensor_read(s_, samples, max, timeout_ms); }
+    int fd() const { return jsensor_fd(s_); }
+    int arm() { return jsensor_arm(s_); }
+    unsigned long long dropped() const { return jsensor_dropped(s_); }
+
+private:
+    struct jsensor *s_;
+};
+#endif
+
+#endif